@@ -12,7 +12,19 @@
 #include "lib/Random.hpp"
 #include "lib/StringInterpolationVars.hpp"
 #include "lib/ShutdownMonitor.hpp"
+#include "lib/ScheduledTaskRunner.hpp"
+#include "lib/CpuTopology.hpp"
+#include "lib/Histogram.hpp"
+#include "lib/TraceRecorder.hpp"
+#include "lib/PoolAllocator.hpp"
+#include "lib/Future.hpp"
 #include "lib/Task.hpp"
 #include "lib/TaskRunner.hpp"
+#include "lib/Channel.hpp"
+#include "lib/SpscRingBuffer.hpp"
+#include "lib/CoTask.hpp"
+#include "lib/TaskGraph.hpp"
+#include "lib/TaskGroup.hpp"
+#include "lib/parallel.hpp"
 
 #endif // GLITCHYBYTE_GB
@@ -0,0 +1,275 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "Task.hpp"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb {
+
+    /**
+     * Bounded multi-producer multi-consumer queue to pass values between tasks.
+     *
+     * <p>Values go through a lock-free ring buffer. Only the blocking variants take a lock, and
+     * only when they have to wait.
+     *
+     * <p>Once closed, pushes fail and pops drain the values still in the channel.
+     *
+     * <p>Blocking waits from within a task running on a TaskRunner also end when the task is
+     * canceled.
+     *
+     * @tparam T Value type.
+     */
+    template<typename T>
+    class Channel {
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            alignas(T) std::byte storage[sizeof(T)];
+
+            T* value() noexcept {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+        };
+
+        static constexpr size_t closedBit { ~(SIZE_MAX >> 1) };
+
+        size_t const mask;
+        std::unique_ptr<Cell[]> const cells;
+        alignas(64) std::atomic<size_t> enqueuePosition { 0 };
+        alignas(64) std::atomic<size_t> dequeuePosition { 0 };
+        alignas(64) std::atomic<size_t> waitingProducers { 0 };
+        std::atomic<size_t> waitingConsumers { 0 };
+        std::mutex waitLock;
+        std::condition_variable_any notFullSignal;
+        std::condition_variable_any notEmptySignal;
+
+    public:
+        /**
+         * Creates a channel.
+         *
+         * @param capacity Maximum number of values in the channel, rounded up to a power of 2.
+         */
+        explicit Channel(size_t const capacity) noexcept :
+            mask(std::bit_ceil(std::max(capacity, size_t { 2 })) - 1), cells(new Cell[mask + 1]) {
+            for (size_t i = 0; i <= mask; ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        Channel(Channel const&) = delete;
+
+        Channel& operator=(Channel const&) = delete;
+
+        ~Channel() noexcept {
+            while (tryPop()) {}
+        }
+
+        /**
+         * Returns the maximum number of values in the channel.
+         *
+         * @return The maximum number of values in the channel.
+         */
+        [[nodiscard]]
+        size_t capacity() const noexcept {
+            return mask + 1;
+        }
+
+        /**
+         * Returns the number of values in the channel. It may be stale by the time it returns.
+         *
+         * @return The number of values in the channel.
+         */
+        [[nodiscard]]
+        size_t size() const noexcept {
+            size_t const dequeued { dequeuePosition.load(std::memory_order_acquire) };
+            size_t const enqueued { enqueuePosition.load(std::memory_order_acquire) & ~closedBit };
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        /**
+         * Closes the channel.
+         *
+         * <p>Pushes fail from now on, and blocked waits wake up.
+         */
+        void close() noexcept {
+            enqueuePosition.fetch_or(closedBit, std::memory_order_acq_rel);
+            std::lock_guard<std::mutex> lock { waitLock };
+            notFullSignal.notify_all();
+            notEmptySignal.notify_all();
+        }
+
+        /**
+         * Tests if the channel is closed.
+         *
+         * @return True if the channel is closed.
+         */
+        [[nodiscard]]
+        bool isClosed() const noexcept {
+            return (enqueuePosition.load(std::memory_order_acquire) & closedBit) != 0;
+        }
+
+        /**
+         * Pushes a value if there is room, without blocking.
+         *
+         * <p>The value is only moved from if it's pushed.
+         *
+         * @tparam U Value type.
+         * @param value Value to push.
+         * @return True if pushed, false if the channel is full or closed.
+         */
+        template<typename U>
+        bool tryPush(U&& value) noexcept {
+            size_t position { enqueuePosition.load(std::memory_order_relaxed) };
+            Cell* cell;
+            while (true) {
+                if ((position & closedBit) != 0) {
+                    return false;
+                }
+                cell = &cells[position & mask];
+                size_t const sequence { cell->sequence.load(std::memory_order_acquire) };
+                intptr_t const difference { static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position) };
+                if (difference == 0) {
+                    if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+            new (cell->storage) T(std::forward<U>(value));
+            cell->sequence.store(position + 1, std::memory_order_release);
+            notify(waitingConsumers, notEmptySignal);
+            return true;
+        }
+
+        /**
+         * Pops a value if there is one, without blocking.
+         *
+         * @return The value, or empty if the channel is empty.
+         */
+        std::optional<T> tryPop() noexcept {
+            size_t position { dequeuePosition.load(std::memory_order_relaxed) };
+            Cell* cell;
+            while (true) {
+                cell = &cells[position & mask];
+                size_t const sequence { cell->sequence.load(std::memory_order_acquire) };
+                intptr_t const difference { static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1) };
+                if (difference == 0) {
+                    if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (difference < 0) {
+                    return std::nullopt;
+                } else {
+                    position = dequeuePosition.load(std::memory_order_relaxed);
+                }
+            }
+            T* const value { cell->value() };
+            std::optional<T> result { std::move(*value) };
+            value->~T();
+            cell->sequence.store(position + mask + 1, std::memory_order_release);
+            notify(waitingProducers, notFullSignal);
+            return result;
+        }
+
+        /**
+         * Pushes a value, blocking while the channel is full.
+         *
+         * <p>The value is only moved from if it's pushed.
+         *
+         * @tparam U Value type.
+         * @param value Value to push.
+         * @return True if pushed, false if the channel is closed or the calling task was canceled.
+         */
+        template<typename U>
+        bool push(U&& value) noexcept {
+            while (true) {
+                if (tryPush(std::forward<U>(value))) {
+                    return true;
+                }
+                if (isClosed() || !await(waitingProducers, notFullSignal, [this]{ return canPush(); })) {
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * Pops a value, blocking while the channel is empty.
+         *
+         * @return The value, or empty if the channel is closed and drained or the calling task
+         *     was canceled.
+         */
+        std::optional<T> pop() noexcept {
+            while (true) {
+                std::optional<T> value { tryPop() };
+                if (value) {
+                    return value;
+                }
+                if (isDrained() || !await(waitingConsumers, notEmptySignal, [this]{ return canPop(); })) {
+                    return std::nullopt;
+                }
+            }
+        }
+
+    private:
+        [[nodiscard]]
+        bool canPush() const noexcept {
+            size_t const position { enqueuePosition.load(std::memory_order_acquire) };
+            if ((position & closedBit) != 0) {
+                return true;
+            }
+            return cells[position & mask].sequence.load(std::memory_order_acquire) == position;
+        }
+
+        [[nodiscard]]
+        bool canPop() const noexcept {
+            size_t const position { dequeuePosition.load(std::memory_order_acquire) };
+            return (cells[position & mask].sequence.load(std::memory_order_acquire) == position + 1) || isDrained();
+        }
+
+        // Closed with nothing left, not even values still being pushed.
+        [[nodiscard]]
+        bool isDrained() const noexcept {
+            size_t const enqueued { enqueuePosition.load(std::memory_order_acquire) };
+            return ((enqueued & closedBit) != 0) &&
+                (dequeuePosition.load(std::memory_order_acquire) == (enqueued & ~closedBit));
+        }
+
+        void notify(std::atomic<size_t>& waiting, std::condition_variable_any& signal) noexcept {
+            // Pairs with the fence in await, so either the waiter sees the change or we see the waiter.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock { waitLock };
+            signal.notify_one();
+        }
+
+        // Returns false if the calling task was canceled.
+        template<typename P>
+        bool await(std::atomic<size_t>& waiting, std::condition_variable_any& signal, P const& isReady) noexcept {
+            Task* const task { Task::currentTask };
+            std::stop_token const stopToken { task != nullptr ? task->getStopToken() : std::stop_token {} };
+            std::unique_lock<std::mutex> lock { waitLock };
+            waiting.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool const ready { signal.wait(lock, stopToken, isReady) };
+            waiting.fetch_sub(1, std::memory_order_relaxed);
+            return ready;
+        }
+    };
+}
@@ -0,0 +1,510 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "Task.hpp"
+#include "TaskRunner.hpp"
+#include <coroutine>
+#include <optional>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <exception>
+#include <stop_token>
+#include <cstdint>
+
+namespace gb {
+
+    /**
+     * Task that runs a coroutine, shared by all coroutine task result types.
+     *
+     * <p>The coroutine only takes a thread while it runs. When it suspends, on a pooled runner the
+     * worker is released, and the task is enqueued again when it's resumed. This makes it
+     * possible to have many more live coroutine tasks than threads.
+     *
+     * <p>Don't use directly. Write coroutines returning CoTask and start them with a TaskRunner.
+     */
+    class CoTaskBase : public Task, public std::enable_shared_from_this<CoTaskBase> {
+        friend class TaskRunner;
+
+        template<typename T>
+        friend class CoTask;
+
+    public:
+        /**
+         * Coroutine promise base, it links the coroutine frame to its task.
+         */
+        struct Promise {
+            CoTaskBase* task { nullptr };
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                std::terminate();
+            }
+        };
+
+        /**
+         * Awaitable that suspends the coroutine for a given time.
+         */
+        class SleepAwaiter {
+        private:
+            std::chrono::steady_clock::duration const delay;
+            CoTaskBase* task { nullptr };
+
+        public:
+            explicit SleepAwaiter(std::chrono::steady_clock::duration const delay) noexcept : delay(delay) {}
+
+            [[nodiscard]]
+            bool await_ready() const noexcept {
+                return delay <= std::chrono::steady_clock::duration::zero();
+            }
+
+            template<std::derived_from<Promise> P>
+            void await_suspend(std::coroutine_handle<P> const handle) noexcept {
+                task = handle.promise().task;
+                task->sleep(delay);
+            }
+
+            void await_resume() const noexcept {
+                if (task != nullptr) {
+                    task->endSleep();
+                }
+            }
+        };
+
+        /**
+         * Awaitable that doesn't suspend and yields true if the coroutine task was canceled.
+         */
+        class CancelAwaiter {
+        private:
+            CoTaskBase* task { nullptr };
+
+        public:
+            [[nodiscard]]
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            template<std::derived_from<Promise> P>
+            bool await_suspend(std::coroutine_handle<P> const handle) noexcept {
+                task = handle.promise().task;
+                return false;
+            }
+
+            [[nodiscard]]
+            bool await_resume() const noexcept {
+                return task->shouldCancel();
+            }
+        };
+
+    private:
+        // Stop callback that ends a sleep early.
+        struct SleepWaker {
+            CoTaskBase* task;
+            uint64_t id;
+
+            void operator()() noexcept {
+                task->wakeFromSleep(id);
+            }
+        };
+
+        enum class ResumeState : int {
+            Running,
+            Suspended,
+            Notified
+        };
+
+        std::coroutine_handle<> handle;
+        std::atomic<ResumeState> resumeState { ResumeState::Running };
+        std::atomic<bool> launched { false };
+        // Sleep state, only touched by the coroutine itself except for sleepingId.
+        uint64_t sleepCount { 0 };
+        std::atomic<uint64_t> sleepingId { 0 };
+        ScheduledTaskRunner::Handle sleepTimer;
+        std::optional<std::stop_callback<SleepWaker>> sleepStopCallback;
+        bool completed { false };
+        std::vector<std::shared_ptr<CoTaskBase>> continuations;
+
+    protected:
+        /**
+         * Creates a task that owns the given coroutine frame.
+         *
+         * @param handle Coroutine handle.
+         */
+        explicit CoTaskBase(std::coroutine_handle<> const handle) noexcept : handle(handle) {}
+
+    public:
+        ~CoTaskBase() noexcept override {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+    protected:
+        /**
+         * Runs the coroutine on its own thread, blocking between resumptions.
+         *
+         * <p>Only used on runners that are not pooled.
+         */
+        void action() noexcept override {
+            started();
+            while (!resume()) {
+                resumeState.wait(ResumeState::Suspended);
+                getTaskRunner()->beginHeartbeat(*this);
+            }
+        }
+
+    private:
+        bool run() noexcept override {
+            started();
+            return resume();
+        }
+
+        bool canSuspend() const noexcept override {
+            return true;
+        }
+
+        // The frame may own tasks that hold this one as a continuation, so it's destroyed to
+        // break the cycle. Continuations are dropped, never resumed.
+        void abandon() noexcept override {
+            sleepStopCallback.reset();
+            if (sleepTimer.isValid()) {
+                sleepTimer.cancel();
+                sleepTimer = {};
+            }
+            std::vector<std::shared_ptr<CoTaskBase>> toDrop;
+            std::unique_lock<std::mutex> lock { stateLock };
+            toDrop.swap(continuations);
+            lock.unlock();
+            if (handle) {
+                handle.destroy();
+                handle = nullptr;
+            }
+            Task::abandon();
+        }
+
+        // Resumes the coroutine until it suspends or completes. Returns true if completed.
+        bool resume() noexcept {
+            while (true) {
+                handle.resume();
+                if (handle.done()) {
+                    complete();
+                    return true;
+                }
+                TaskRunner* const runner { getTaskRunner() };
+                // Once suspended, it may be resumed elsewhere right away.
+                runner->endHeartbeat(*this);
+                ResumeState expected { ResumeState::Running };
+                if (resumeState.compare_exchange_strong(expected, ResumeState::Suspended)) {
+                    return false;
+                }
+                // Woken up before we got to suspend, so keep going on this thread.
+                resumeState = ResumeState::Running;
+                runner->beginHeartbeat(*this);
+            }
+        }
+
+        void wake() noexcept {
+            ResumeState current { resumeState };
+            while (true) {
+                if (current == ResumeState::Suspended) {
+                    if (resumeState.compare_exchange_weak(current, ResumeState::Running)) {
+                        TaskRunner* const runner { getTaskRunner() };
+                        if (runner->queuesTasks()) {
+                            runner->enqueueTask(shared_from_this());
+                        } else {
+                            resumeState.notify_one();
+                        }
+                        return;
+                    }
+                } else if (current == ResumeState::Running) {
+                    if (resumeState.compare_exchange_weak(current, ResumeState::Notified)) {
+                        return;
+                    }
+                } else {
+                    return;
+                }
+            }
+        }
+
+        // Wakes up after the delay, or right away when canceled.
+        void sleep(std::chrono::steady_clock::duration const delay) noexcept {
+            uint64_t const id { ++sleepCount };
+            sleepingId = id;
+            sleepTimer = getTaskRunner()->runAfter(delay, [self = shared_from_this(), id]{ self->wakeFromSleep(id); });
+            // Runs right away if already canceled.
+            sleepStopCallback.emplace(getStopToken(), SleepWaker { this, id });
+        }
+
+        void wakeFromSleep(uint64_t const id) noexcept {
+            uint64_t expected { id };
+            if (sleepingId.compare_exchange_strong(expected, 0)) {
+                wake();
+            }
+        }
+
+        void endSleep() noexcept {
+            sleepStopCallback.reset();
+            if (sleepTimer.isValid()) {
+                // Woken up early, so the timer drops it instead.
+                sleepTimer.cancel();
+                sleepTimer = {};
+            }
+        }
+
+        void complete() noexcept {
+            handle.destroy();
+            handle = nullptr;
+            std::vector<std::shared_ptr<CoTaskBase>> toWake;
+            std::unique_lock<std::mutex> lock { stateLock };
+            completed = true;
+            toWake.swap(continuations);
+            lock.unlock();
+            for (auto const& task: toWake) {
+                task->wake();
+            }
+        }
+
+        [[nodiscard]]
+        bool isCompleted() noexcept {
+            std::lock_guard<std::mutex> lock { stateLock };
+            return completed;
+        }
+
+        // Returns false if already completed, in which case the continuation will not be woken.
+        bool addContinuation(std::shared_ptr<CoTaskBase>&& task) noexcept {
+            std::lock_guard<std::mutex> lock { stateLock };
+            if (completed) {
+                return false;
+            }
+            continuations.push_back(std::move(task));
+            return true;
+        }
+
+        // Awaited tasks skip admission, the awaiting task can't go on without them.
+        bool launch(TaskRunner& runner, bool const isAwaited = false) noexcept {
+            if (launched.exchange(true)) {
+                return false;
+            }
+            return runner.startTask(shared_from_this(), false, isAwaited);
+        }
+
+        // Starts this task on the awaiting task's runner if needed. Returns false if already
+        // completed, in which case the awaiting task should not suspend.
+        bool suspendUntilCompleted(CoTaskBase* const awaitingTask) noexcept {
+            launch(*awaitingTask->getTaskRunner(), true);
+            return addContinuation(awaitingTask->shared_from_this());
+        }
+    };
+
+    /**
+     * Coroutine task state holding its result.
+     *
+     * @tparam T Result type.
+     */
+    template<typename T>
+    class CoTaskState : public CoTaskBase {
+    public:
+        std::optional<T> result;
+
+        explicit CoTaskState(std::coroutine_handle<> const handle) noexcept : CoTaskBase(handle) {}
+    };
+
+    /**
+     * Coroutine task state for coroutines without a result.
+     */
+    template<>
+    class CoTaskState<void> : public CoTaskBase {
+    public:
+        explicit CoTaskState(std::coroutine_handle<> const handle) noexcept : CoTaskBase(handle) {}
+    };
+
+    /**
+     * Coroutine promise that stores the result.
+     *
+     * @tparam T Result type.
+     */
+    template<typename T>
+    struct CoTaskPromise : public CoTaskBase::Promise {
+        void return_value(T value) noexcept {
+            static_cast<CoTaskState<T>*>(task)->result.emplace(std::move(value));
+        }
+    };
+
+    /**
+     * Coroutine promise for coroutines without a result.
+     */
+    template<>
+    struct CoTaskPromise<void> : public CoTaskBase::Promise {
+        void return_void() noexcept {}
+    };
+
+    /**
+     * A coroutine task that a TaskRunner can suspend and resume on a small set of threads.
+     *
+     * <p>Any coroutine returning CoTask is a coroutine task. It doesn't run until it's started with
+     * TaskRunner::start, or awaited from another coroutine task, in which case it's started on
+     * the same runner.
+     *
+     * <p>Within the coroutine:
+     * <ul>
+     *     <li><code>co_await gb::coSleep(duration)</code> suspends it without holding a thread.</li>
+     *     <li><code>co_await gb::coShouldCancel()</code> yields true if it was canceled and should exit.</li>
+     *     <li><code>co_await otherCoTask</code> suspends it until the other one completes, and yields its result.</li>
+     * </ul>
+     *
+     * @tparam T Result type.
+     */
+    template<typename T = void>
+    class CoTask {
+        friend class TaskRunner;
+
+    public:
+        /**
+         * Coroutine promise type.
+         */
+        struct promise_type : public CoTaskPromise<T> {
+            CoTask get_return_object() noexcept {
+                std::shared_ptr<CoTaskState<T>> state {
+                    std::make_shared<CoTaskState<T>>(std::coroutine_handle<promise_type>::from_promise(*this))
+                };
+                this->task = state.get();
+                return CoTask { std::move(state) };
+            }
+        };
+
+        /**
+         * Awaitable that suspends a coroutine task until this one completes.
+         */
+        class Awaiter {
+        private:
+            std::shared_ptr<CoTaskState<T>> const state;
+
+        public:
+            explicit Awaiter(std::shared_ptr<CoTaskState<T>> const& state) noexcept : state(state) {}
+
+            [[nodiscard]]
+            bool await_ready() const noexcept {
+                return isCompleted(*state);
+            }
+
+            template<std::derived_from<CoTaskBase::Promise> P>
+            bool await_suspend(std::coroutine_handle<P> const handle) const noexcept {
+                return suspendUntilCompleted(*state, handle.promise().task);
+            }
+
+            T await_resume() const noexcept {
+                if constexpr (!std::is_void_v<T>) {
+                    return *state->result;
+                }
+            }
+        };
+
+    private:
+        std::shared_ptr<CoTaskState<T>> state;
+
+        explicit CoTask(std::shared_ptr<CoTaskState<T>>&& state) noexcept : state(std::move(state)) {}
+
+        [[nodiscard]]
+        static bool isCompleted(CoTaskBase& task) noexcept {
+            return task.isCompleted();
+        }
+
+        static bool suspendUntilCompleted(CoTaskBase& task, CoTaskBase* const awaitingTask) noexcept {
+            return task.suspendUntilCompleted(awaitingTask);
+        }
+
+    public:
+        /**
+         * Returns the current state of the coroutine task.
+         *
+         * @return The current state of the coroutine task.
+         */
+        [[nodiscard]]
+        Task::State getState() const noexcept {
+            return state->getState();
+        }
+
+        /**
+         * Signals the coroutine task to cancel.
+         *
+         * <p>It's up to the coroutine itself to check for its cancellation and needing to exit.
+         */
+        void cancel() const noexcept {
+            state->cancel();
+        }
+
+        /**
+         * Blocks the calling thread until the coroutine task stops.
+         *
+         * <p>Don't call from within a coroutine, await the coroutine task instead.
+         */
+        void awaitStop() const noexcept {
+            state->awaitStop();
+        }
+
+        /**
+         * Tests if the coroutine task has stopped.
+         *
+         * @return True if the coroutine task has stopped.
+         */
+        [[nodiscard]]
+        bool isStopped() const noexcept {
+            return state->isStopped();
+        }
+
+        /**
+         * Returns the result of the coroutine.
+         *
+         * <p>Only valid once the coroutine task has stopped.
+         *
+         * @return The result of the coroutine.
+         */
+        template<typename U = T>
+            requires (!std::is_void_v<U>)
+        [[nodiscard]]
+        U const& getResult() const noexcept {
+            return *state->result;
+        }
+
+        Awaiter operator co_await() const noexcept {
+            return Awaiter { state };
+        }
+    };
+
+    template<typename T>
+    bool TaskRunner::start(CoTask<T> const& coTask) noexcept {
+        return coTask.state->launch(*this);
+    }
+
+    /**
+     * Suspends the calling coroutine task for the given time without holding a thread.
+     *
+     * <p>It wakes up early if the coroutine task is canceled.
+     *
+     * @param duration Time to sleep.
+     * @return An awaitable.
+     */
+    [[nodiscard]]
+    inline CoTaskBase::SleepAwaiter coSleep(std::chrono::steady_clock::duration const duration) noexcept {
+        return CoTaskBase::SleepAwaiter { duration };
+    }
+
+    /**
+     * Checks if the calling coroutine task was canceled, without suspending it.
+     *
+     * @return An awaitable that yields true if the coroutine task was canceled and should exit.
+     */
+    [[nodiscard]]
+    inline CoTaskBase::CancelAwaiter coShouldCancel() noexcept {
+        return CoTaskBase::CancelAwaiter {};
+    }
+}
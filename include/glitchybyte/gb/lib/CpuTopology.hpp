@@ -0,0 +1,193 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace gb {
+
+    /**
+     * CPUs of the machine grouped by NUMA node.
+     *
+     * <p>On Linux it's read from /sys, limited to the CPUs the process may run on. Nodes are
+     * indexed by their id, so nodes missing from the numbering, or without CPUs the process may
+     * run on, are kept with no CPUs. Elsewhere, or if /sys doesn't say, all CPUs are in a single
+     * node.
+     */
+    class CpuTopology {
+    public:
+        /**
+         * CPU ids are below this bound, the most a thread can be pinned to.
+         */
+#ifdef __linux__
+        static constexpr unsigned maxCpuCount { CPU_SETSIZE };
+#else
+        static constexpr unsigned maxCpuCount { 1024 };
+#endif
+
+    private:
+        std::vector<std::vector<unsigned>> nodes;
+
+    public:
+        /**
+         * Detects the topology of the machine.
+         *
+         * @return The topology of the machine.
+         */
+        [[nodiscard]]
+        static CpuTopology detect() noexcept {
+            std::vector<unsigned> const allowed { getAllowedCpus() };
+            std::vector<std::vector<unsigned>> nodes;
+#ifdef __linux__
+            // Node ids may have gaps, so stop after a run of missing ones.
+            for (unsigned node = 0, missing = 0; missing < 64; ++node) {
+                std::ifstream file { "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist" };
+                std::string cpuList;
+                if (!std::getline(file, cpuList)) {
+                    ++missing;
+                    continue;
+                }
+                missing = 0;
+                std::vector<unsigned> cpus { parseCpuList(cpuList) };
+                std::erase_if(cpus, [&allowed](unsigned const cpu) { return !std::ranges::binary_search(allowed, cpu); });
+                nodes.resize(node + 1);
+                nodes[node] = std::move(cpus);
+            }
+#endif
+            if (std::ranges::all_of(nodes, [](std::vector<unsigned> const& cpus) { return cpus.empty(); })) {
+                nodes = { allowed };
+            }
+            return CpuTopology { std::move(nodes) };
+        }
+
+        /**
+         * Parses a Linux CPU list, like "0-3,8,10-11".
+         *
+         * <p>Parsing stops at the first malformed entry, a reversed range, or a CPU id of
+         * maxCpuCount or more. The CPUs before it are kept.
+         *
+         * @param cpuList CPU list.
+         * @return The CPUs in the list, sorted.
+         */
+        [[nodiscard]]
+        static std::vector<unsigned> parseCpuList(std::string_view const cpuList) noexcept {
+            std::vector<unsigned> cpus;
+            char const* current { cpuList.data() };
+            char const* const end { cpuList.data() + cpuList.size() };
+            while (current < end) {
+                unsigned first;
+                auto result { std::from_chars(current, end, first) };
+                if (result.ec != std::errc {}) {
+                    break;
+                }
+                unsigned last { first };
+                if ((result.ptr < end) && (*result.ptr == '-')) {
+                    result = std::from_chars(result.ptr + 1, end, last);
+                    if (result.ec != std::errc {}) {
+                        break;
+                    }
+                }
+                if ((last < first) || (last >= maxCpuCount)) {
+                    break;
+                }
+                for (unsigned cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+                current = result.ptr;
+                if ((current < end) && (*current == ',')) {
+                    ++current;
+                } else {
+                    break;
+                }
+            }
+            std::ranges::sort(cpus);
+            cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+            return cpus;
+        }
+
+        /**
+         * Restricts the calling thread to run on the given CPUs.
+         *
+         * @param cpus CPUs to run on.
+         * @return True if the thread was pinned, false if it failed or is not supported here.
+         */
+        static bool pinCurrentThread(std::span<unsigned const> const cpus) noexcept {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (unsigned const cpu: cpus) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            return (CPU_COUNT(&set) > 0) && (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * Creates a topology from the given nodes.
+         *
+         * @param nodes CPUs of each node.
+         */
+        explicit CpuTopology(std::vector<std::vector<unsigned>> nodes) noexcept : nodes(std::move(nodes)) {}
+
+        /**
+         * Returns the number of NUMA nodes, including those without CPUs.
+         *
+         * @return The number of NUMA nodes, one more than the highest node id.
+         */
+        [[nodiscard]]
+        size_t getNodeCount() const noexcept {
+            return nodes.size();
+        }
+
+        /**
+         * Returns the CPUs of a node.
+         *
+         * @param node Node id.
+         * @return The CPUs of the node, sorted. Empty if the process may not run on any of them.
+         */
+        [[nodiscard]]
+        std::vector<unsigned> const& getCpus(size_t const node) const noexcept {
+            return nodes[node];
+        }
+
+    private:
+        [[nodiscard]]
+        static std::vector<unsigned> getAllowedCpus() noexcept {
+            std::vector<unsigned> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            if (cpus.empty()) {
+                unsigned const count { std::max(std::thread::hardware_concurrency(), 1u) };
+                for (unsigned cpu = 0; cpu < count; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+    };
+}
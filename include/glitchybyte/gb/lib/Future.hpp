@@ -0,0 +1,311 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "PoolAllocator.hpp"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <variant>
+#include <functional>
+#include <type_traits>
+#include <cassert>
+
+namespace gb {
+
+    template<typename T>
+    class Future;
+
+    /**
+     * Result type of a continuation function applied to a value of the given type.
+     *
+     * @tparam F Function type.
+     * @tparam T Value type.
+     */
+    template<typename F, typename T>
+    struct FutureThenResult {
+        using type = std::invoke_result_t<F&, T const&>;
+    };
+
+    /**
+     * Result type of a continuation function of a future of void.
+     *
+     * @tparam F Function type.
+     */
+    template<typename F>
+    struct FutureThenResult<F, void> {
+        using type = std::invoke_result_t<F&>;
+    };
+
+    /**
+     * Continuation that runs when a future's value is set.
+     */
+    class FutureContinuation {
+    public:
+        /**
+         * Next continuation waiting on the same future.
+         */
+        FutureContinuation* next { nullptr };
+
+        virtual ~FutureContinuation() noexcept = default;
+
+        /**
+         * Runs the continuation.
+         */
+        virtual void run() noexcept = 0;
+    };
+
+    /**
+     * State shared by a future and the producer of its value.
+     *
+     * <p>Producers derive from it, so the value, its waiters and the producer itself can live in
+     * a single allocation.
+     *
+     * @tparam T Value type.
+     */
+    template<typename T>
+    class FutureState {
+        template<typename U>
+        friend class Future;
+
+        template<typename F, typename S, typename U>
+        friend class ThenFutureState;
+
+    private:
+        class CompletedMarker : public FutureContinuation {
+        public:
+            void run() noexcept override {}
+        };
+
+        static inline CompletedMarker completedMarker;
+
+    protected:
+        /**
+         * Stored value type. Futures of void store an empty value.
+         */
+        using Value = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    private:
+        std::optional<Value> value;
+        std::atomic<bool> ready { false };
+        std::atomic<FutureContinuation*> continuations { nullptr };
+
+    public:
+        virtual ~FutureState() noexcept = default;
+
+        /**
+         * Sets the value, wakes up waiters and runs continuations on the calling thread.
+         *
+         * <p>It MUST be called only once.
+         *
+         * @tparam Args Value constructor argument types.
+         * @param args Value constructor arguments.
+         */
+        template<typename... Args>
+        void complete(Args&&... args) noexcept {
+            value.emplace(std::forward<Args>(args)...);
+            publish();
+        }
+
+        /**
+         * Completes without a value, because none is coming, like when its task was canceled
+         * before running. Wakes up waiters, and continuations complete canceled too.
+         *
+         * <p>It MUST be called only once, and not along with complete.
+         */
+        void completeCanceled() noexcept {
+            publish();
+        }
+
+    private:
+        void publish() noexcept {
+            ready.store(true, std::memory_order_release);
+            ready.notify_all();
+            FutureContinuation* pending { continuations.exchange(&completedMarker, std::memory_order_acq_rel) };
+            // Continuations were pushed in reverse order.
+            FutureContinuation* ordered { nullptr };
+            while (pending != nullptr) {
+                FutureContinuation* const next { pending->next };
+                pending->next = ordered;
+                ordered = pending;
+                pending = next;
+            }
+            while (ordered != nullptr) {
+                FutureContinuation* const next { ordered->next };
+                ordered->run();
+                ordered = next;
+            }
+        }
+
+        void addContinuation(FutureContinuation* const continuation) noexcept {
+            FutureContinuation* head { continuations.load(std::memory_order_acquire) };
+            do {
+                if (head == &completedMarker) {
+                    continuation->run();
+                    return;
+                }
+                continuation->next = head;
+            } while (!continuations.compare_exchange_weak(head, continuation, std::memory_order_acq_rel, std::memory_order_acquire));
+        }
+    };
+
+    /**
+     * Future state of a continuation, which applies a function to the value of another future.
+     *
+     * @tparam F Function type.
+     * @tparam T Source value type.
+     * @tparam U Value type.
+     */
+    template<typename F, typename T, typename U>
+    class ThenFutureState : public FutureState<U>, public FutureContinuation {
+        template<typename V>
+        friend class Future;
+
+    private:
+        F fn;
+        std::shared_ptr<FutureState<T>> const source;
+        std::shared_ptr<ThenFutureState> self;
+
+    public:
+        ThenFutureState(F&& fn, std::shared_ptr<FutureState<T>> const& source) noexcept :
+            fn(std::move(fn)), source(source) {}
+
+        void run() noexcept override {
+            // Keeps this alive until done, even if the future was dropped.
+            std::shared_ptr<ThenFutureState> const keepAlive { std::move(self) };
+            if (!source->value) {
+                this->completeCanceled();
+                return;
+            }
+            if constexpr (std::is_void_v<T>) {
+                if constexpr (std::is_void_v<U>) {
+                    fn();
+                    this->complete();
+                } else {
+                    this->complete(fn());
+                }
+            } else {
+                T const& value { *source->value };
+                if constexpr (std::is_void_v<U>) {
+                    fn(value);
+                    this->complete();
+                } else {
+                    this->complete(fn(value));
+                }
+            }
+        }
+    };
+
+    /**
+     * A value that will be available in the future.
+     *
+     * <p>Continuations added with then run on the thread that sets the value, or right away on the
+     * calling thread if the value is already available.
+     *
+     * <p>Runners return an invalid future when they don't accept a task. Check isValid before
+     * getting its value.
+     *
+     * @tparam T Value type.
+     */
+    template<typename T>
+    class Future {
+    private:
+        std::shared_ptr<FutureState<T>> state;
+
+    public:
+        /**
+         * Creates an invalid future, with no value coming.
+         */
+        Future() noexcept = default;
+
+        /**
+         * Creates a future for the given state.
+         *
+         * @param state Shared state.
+         */
+        explicit Future(std::shared_ptr<FutureState<T>> state) noexcept : state(std::move(state)) {}
+
+        /**
+         * Returns true if a value is coming.
+         *
+         * @return True if a value is coming.
+         */
+        [[nodiscard]]
+        bool isValid() const noexcept {
+            return state != nullptr;
+        }
+
+        /**
+         * Returns true if the value is available.
+         *
+         * @return True if the value is available, false if it's not yet or the future is invalid.
+         */
+        [[nodiscard]]
+        bool isReady() const noexcept {
+            return isValid() && state->ready.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Returns true if the future completed without a value, because its task was canceled
+         * before running.
+         *
+         * @return True if the future completed without a value.
+         */
+        [[nodiscard]]
+        bool isCanceled() const noexcept {
+            return isReady() && !state->value;
+        }
+
+        /**
+         * Blocks the calling thread until the value is available, or the future is canceled.
+         *
+         * <p>Returns right away if the future is invalid.
+         */
+        void wait() const noexcept {
+            if (isValid()) {
+                state->ready.wait(false, std::memory_order_acquire);
+            }
+        }
+
+        /**
+         * Blocks the calling thread until the value is available, and returns it.
+         *
+         * <p>The future MUST be valid, and not be canceled.
+         *
+         * @return The value.
+         */
+        template<typename U = T>
+            requires (!std::is_void_v<U>)
+        [[nodiscard]]
+        U const& get() const noexcept {
+            assert(isValid() && "get called on an invalid future");
+            wait();
+            assert(state->value && "get called on a canceled future");
+            return *state->value;
+        }
+
+        /**
+         * Adds a continuation that applies a function to the value.
+         *
+         * @tparam F Function type.
+         * @param fn Function that takes the value, or nothing for futures of void. It isn't called
+         *     if this future is canceled, and the returned one is canceled too.
+         * @return A future for the result of the function, invalid if this future is invalid.
+         */
+        template<typename F>
+        auto then(F&& fn) const noexcept {
+            using Fn = std::decay_t<F>;
+            using U = typename FutureThenResult<Fn, T>::type;
+            if (!isValid()) {
+                return Future<U> {};
+            }
+            std::shared_ptr<ThenFutureState<Fn, T, U>> next {
+                std::allocate_shared<ThenFutureState<Fn, T, U>>(PoolAllocator<ThenFutureState<Fn, T, U>> {}, Fn { std::forward<F>(fn) }, state)
+            };
+            next->self = next;
+            state->addContinuation(next.get());
+            return Future<U> { std::move(next) };
+        }
+    };
+}
@@ -0,0 +1,175 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+namespace gb {
+
+    /**
+     * Lock-free histogram of unsigned values, like latencies in nanoseconds.
+     *
+     * <p>Buckets are log-linear, as in HDR histograms: every power of 2 range is split in 32
+     * buckets, so any recorded value is known within about 3%, from 0 to the largest 64 bit value.
+     * Recording is a few relaxed atomic adds, and safe from any thread.
+     */
+    class Histogram {
+    private:
+        static constexpr size_t subBucketBits { 5 };
+        static constexpr size_t subBucketCount { 1 << subBucketBits };
+        static constexpr size_t bucketCount { (65 - subBucketBits) * subBucketCount };
+
+        [[nodiscard]]
+        static constexpr size_t bucketIndex(uint64_t const value) noexcept {
+            size_t const width { static_cast<size_t>(std::bit_width(value)) };
+            if (width <= subBucketBits + 1) {
+                return static_cast<size_t>(value);
+            }
+            size_t const shift { width - subBucketBits - 1 };
+            return shift * subBucketCount + static_cast<size_t>(value >> shift);
+        }
+
+        // Middle value of a bucket, which is within half a bucket of anything recorded in it.
+        [[nodiscard]]
+        static constexpr uint64_t bucketValue(size_t const index) noexcept {
+            if (index < subBucketCount * 2) {
+                return index;
+            }
+            size_t const shift { index / subBucketCount - 1 };
+            uint64_t const lowest { static_cast<uint64_t>(index - shift * subBucketCount) << shift };
+            return lowest + ((uint64_t { 1 } << shift) >> 1);
+        }
+
+    public:
+        /**
+         * Point in time copy of a histogram.
+         */
+        class Snapshot {
+            friend class Histogram;
+
+        private:
+            std::vector<uint64_t> buckets;
+
+        public:
+            /**
+             * Number of recorded values.
+             */
+            uint64_t count { 0 };
+
+            /**
+             * Smallest recorded value, or 0 if none.
+             */
+            uint64_t min { 0 };
+
+            /**
+             * Largest recorded value, or 0 if none.
+             */
+            uint64_t max { 0 };
+
+            /**
+             * Sum of recorded values.
+             */
+            uint64_t sum { 0 };
+
+            /**
+             * Returns the mean of the recorded values.
+             *
+             * @return The mean of the recorded values, or 0 if none.
+             */
+            [[nodiscard]]
+            double mean() const noexcept {
+                return count > 0 ? static_cast<double>(sum) / static_cast<double>(count) : 0;
+            }
+
+            /**
+             * Returns the value at the given percentile.
+             *
+             * @param percentile Percentile, from 0 to 100.
+             * @return The value at the given percentile, or 0 if none.
+             */
+            [[nodiscard]]
+            uint64_t percentile(double const percentile) const noexcept {
+                uint64_t total { 0 };
+                for (uint64_t const bucket: buckets) {
+                    total += bucket;
+                }
+                if (total == 0) {
+                    return 0;
+                }
+                uint64_t const rank {
+                    std::max(uint64_t { 1 }, static_cast<uint64_t>(std::clamp(percentile, 0.0, 100.0) / 100 * static_cast<double>(total) + 0.5))
+                };
+                if (rank >= total) {
+                    return max;
+                }
+                uint64_t seen { 0 };
+                for (size_t i = 0; i < buckets.size(); ++i) {
+                    seen += buckets[i];
+                    if (seen >= rank) {
+                        return std::clamp(bucketValue(i), min, max);
+                    }
+                }
+                return max;
+            }
+        };
+
+    private:
+        std::array<std::atomic<uint64_t>, bucketCount> buckets {};
+        std::atomic<uint64_t> count { 0 };
+        std::atomic<uint64_t> sum { 0 };
+        std::atomic<uint64_t> min { UINT64_MAX };
+        std::atomic<uint64_t> max { 0 };
+
+    public:
+        /**
+         * Records a value.
+         *
+         * @param value Value to record.
+         */
+        void record(uint64_t const value) noexcept {
+            buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(value, std::memory_order_relaxed);
+            uint64_t currentMin { min.load(std::memory_order_relaxed) };
+            while ((value < currentMin) && !min.compare_exchange_weak(currentMin, value, std::memory_order_relaxed)) {}
+            uint64_t currentMax { max.load(std::memory_order_relaxed) };
+            while ((value > currentMax) && !max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed)) {}
+        }
+
+        /**
+         * Copies the current state of the histogram.
+         *
+         * <p>Values recorded concurrently may be partially included.
+         *
+         * @return A snapshot of the histogram.
+         */
+        [[nodiscard]]
+        Snapshot snapshot() const noexcept {
+            Snapshot snapshot;
+            snapshot.count = count.load(std::memory_order_relaxed);
+            snapshot.sum = sum.load(std::memory_order_relaxed);
+            if (snapshot.count > 0) {
+                snapshot.min = min.load(std::memory_order_relaxed);
+                snapshot.max = max.load(std::memory_order_relaxed);
+            }
+            // Trailing empty buckets are left out.
+            size_t used { 0 };
+            for (size_t i = 0; i < bucketCount; ++i) {
+                if (buckets[i].load(std::memory_order_relaxed) > 0) {
+                    used = i + 1;
+                }
+            }
+            snapshot.buckets.reserve(used);
+            for (size_t i = 0; i < used; ++i) {
+                snapshot.buckets.push_back(buckets[i].load(std::memory_order_relaxed));
+            }
+            return snapshot;
+        }
+    };
+}
@@ -0,0 +1,277 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <new>
+#include <cstddef>
+
+namespace gb {
+
+    /**
+     * Recycles small memory blocks, so allocating them costs no trip to the heap once warmed up.
+     *
+     * <p>Blocks are grouped in size classes of 64 bytes, up to 1024 bytes. Each thread keeps its
+     * own free lists, and hands batches of blocks over to shared ones when it has too many, so
+     * blocks freed by a thread other than the one that allocated them get back into circulation.
+     *
+     * <p>Shared lists keep up to a number of free blocks per size class, and return the rest to
+     * the heap, so a peak of allocations isn't held forever. Call trim to return all the free
+     * blocks that are not held by other threads.
+     */
+    class BlockPool {
+    private:
+        static constexpr size_t classSize { 64 };
+        static constexpr size_t classCount { 16 };
+        static constexpr size_t batchSize { 32 };
+        static constexpr size_t localCapacity { batchSize * 2 };
+        static constexpr size_t sharedCapacity { batchSize * 32 };
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        struct SharedList {
+            std::mutex lock;
+            FreeBlock* head { nullptr };
+            size_t count { 0 };
+        };
+
+        struct LocalList {
+            FreeBlock* head { nullptr };
+            size_t count { 0 };
+        };
+
+        // Hands all blocks over to the shared lists when the thread exits.
+        struct LocalLists {
+            std::array<LocalList, classCount> lists {};
+
+            ~LocalLists() noexcept {
+                for (size_t i = 0; i < classCount; ++i) {
+                    while (lists[i].count > 0) {
+                        giveBatch(lists[i], i);
+                    }
+                }
+                localListsDestroyed = true;
+            }
+        };
+
+        // Blocks may still be freed later in the thread's exit, by other thread_local or static
+        // objects, and then go straight to the shared lists.
+        static inline thread_local bool localListsDestroyed { false };
+
+    public:
+        /**
+         * Largest size of a pooled block.
+         */
+        static constexpr size_t maxSize { classSize * classCount };
+
+        /**
+         * Allocates a block.
+         *
+         * @param size Size of the block, at most maxSize.
+         * @return The block, aligned as any fundamental type.
+         */
+        [[nodiscard]]
+        static void* allocate(size_t const size) noexcept {
+            size_t const index { classIndex(size) };
+            if (localListsDestroyed) {
+                return allocateShared(index);
+            }
+            LocalList& local { getLocalList(index) };
+            if (local.head == nullptr) {
+                takeBatch(getSharedList(index), local);
+                if (local.head == nullptr) {
+                    return ::operator new(blockSize(index));
+                }
+            }
+            FreeBlock* const block { local.head };
+            local.head = block->next;
+            --local.count;
+            return block;
+        }
+
+        /**
+         * Frees a block, from any thread.
+         *
+         * @param pointer Block.
+         * @param size Size it was allocated with.
+         */
+        static void deallocate(void* const pointer, size_t const size) noexcept {
+            size_t const index { classIndex(size) };
+            FreeBlock* const block { static_cast<FreeBlock*>(pointer) };
+            if (localListsDestroyed) {
+                block->next = nullptr;
+                giveBlocks(block, block, 1, index);
+                return;
+            }
+            LocalList& local { getLocalList(index) };
+            block->next = local.head;
+            local.head = block;
+            if (++local.count > localCapacity) {
+                giveBatch(local, index);
+            }
+        }
+
+        /**
+         * Returns the free blocks of the shared lists, and those of the calling thread, to the
+         * heap.
+         *
+         * <p>Other threads keep theirs, up to a couple of batches per size class, until they
+         * exit.
+         */
+        static void trim() noexcept {
+            for (size_t i = 0; i < classCount; ++i) {
+                if (!localListsDestroyed) {
+                    LocalList& local { getLocalList(i) };
+                    FreeBlock* const blocks { local.head };
+                    local.head = nullptr;
+                    local.count = 0;
+                    freeBlocks(blocks, i);
+                }
+                SharedList& shared { getSharedList(i) };
+                std::unique_lock<std::mutex> lock { shared.lock };
+                FreeBlock* const blocks { shared.head };
+                shared.head = nullptr;
+                shared.count = 0;
+                lock.unlock();
+                freeBlocks(blocks, i);
+            }
+        }
+
+    private:
+        [[nodiscard]]
+        static constexpr size_t classIndex(size_t const size) noexcept {
+            return size == 0 ? 0 : (size - 1) / classSize;
+        }
+
+        [[nodiscard]]
+        static constexpr size_t blockSize(size_t const index) noexcept {
+            return (index + 1) * classSize;
+        }
+
+        [[nodiscard]]
+        static SharedList& getSharedList(size_t const index) noexcept {
+            // Never destroyed, static objects may still free blocks at exit.
+            static std::array<SharedList, classCount>* const sharedLists { new std::array<SharedList, classCount> {} };
+            return (*sharedLists)[index];
+        }
+
+        [[nodiscard]]
+        static LocalList& getLocalList(size_t const index) noexcept {
+            static thread_local LocalLists localLists;
+            return localLists.lists[index];
+        }
+
+        static void takeBatch(SharedList& shared, LocalList& local) noexcept {
+            std::lock_guard<std::mutex> lock { shared.lock };
+            for (size_t i = 0; (i < batchSize) && (shared.head != nullptr); ++i) {
+                FreeBlock* const block { shared.head };
+                shared.head = block->next;
+                --shared.count;
+                block->next = local.head;
+                local.head = block;
+                ++local.count;
+            }
+        }
+
+        [[nodiscard]]
+        static void* allocateShared(size_t const index) noexcept {
+            SharedList& shared { getSharedList(index) };
+            std::unique_lock<std::mutex> lock { shared.lock };
+            FreeBlock* const block { shared.head };
+            if (block == nullptr) {
+                lock.unlock();
+                return ::operator new(blockSize(index));
+            }
+            shared.head = block->next;
+            --shared.count;
+            return block;
+        }
+
+        static void giveBatch(LocalList& local, size_t const index) noexcept {
+            // Unlink the batch first, so the lock is only held to splice it in.
+            FreeBlock* const first { local.head };
+            FreeBlock* last { first };
+            size_t count { 1 };
+            while ((count < batchSize) && (last->next != nullptr)) {
+                last = last->next;
+                ++count;
+            }
+            local.head = last->next;
+            local.count -= count;
+            last->next = nullptr;
+            giveBlocks(first, last, count, index);
+        }
+
+        // Splices a list of blocks into the shared list, or frees them if it's full.
+        static void giveBlocks(FreeBlock* const first, FreeBlock* const last, size_t const count, size_t const index) noexcept {
+            SharedList& shared { getSharedList(index) };
+            std::unique_lock<std::mutex> lock { shared.lock };
+            if (shared.count + count <= sharedCapacity) {
+                last->next = shared.head;
+                shared.head = first;
+                shared.count += count;
+                return;
+            }
+            lock.unlock();
+            freeBlocks(first, index);
+        }
+
+        static void freeBlocks(FreeBlock* block, size_t const index) noexcept {
+            while (block != nullptr) {
+                FreeBlock* const next { block->next };
+                ::operator delete(block, blockSize(index));
+                block = next;
+            }
+        }
+    };
+
+    /**
+     * Standard allocator that takes small allocations from the BlockPool.
+     *
+     * <p>Use it with std::allocate_shared, so an object and its control block come from the
+     * pool, or with containers that allocate in small chunks, like std::deque.
+     *
+     * @tparam T Value type.
+     */
+    template<typename T>
+    class PoolAllocator {
+    public:
+        using value_type = T;
+
+        PoolAllocator() noexcept = default;
+
+        template<typename U>
+        PoolAllocator(PoolAllocator<U> const&) noexcept {}
+
+        [[nodiscard]]
+        T* allocate(size_t const n) noexcept {
+            if (isPooled(n)) {
+                return static_cast<T*>(BlockPool::allocate(n * sizeof(T)));
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t { alignof(T) }));
+        }
+
+        void deallocate(T* const pointer, size_t const n) noexcept {
+            if (isPooled(n)) {
+                BlockPool::deallocate(pointer, n * sizeof(T));
+                return;
+            }
+            ::operator delete(pointer, n * sizeof(T), std::align_val_t { alignof(T) });
+        }
+
+        template<typename U>
+        bool operator==(PoolAllocator<U> const&) const noexcept {
+            return true;
+        }
+
+    private:
+        [[nodiscard]]
+        static constexpr bool isPooled(size_t const n) noexcept {
+            return (alignof(T) <= alignof(std::max_align_t)) && (n <= BlockPool::maxSize / sizeof(T));
+        }
+    };
+}
@@ -0,0 +1,457 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+namespace gb {
+
+    class TaskRunner;
+
+    /**
+     * Runs actions after a delay, once or periodically, on a single thread.
+     *
+     * <p>Timers live in a hierarchical timer wheel, so scheduling and canceling cost O(1)
+     * regardless of how many timers are pending. Deadlines are rounded up to the tick resolution.
+     *
+     * <p>Actions run on the runner's thread and delay every other timer while they run. Keep them
+     * short, and hand off long work to a TaskRunner.
+     */
+    class ScheduledTaskRunner {
+        // Simulated task runners keep their own timers, on a virtual clock.
+        friend class TaskRunner;
+
+    private:
+        enum class Recurrence {
+            Once,
+            FixedRate,
+            FixedDelay
+        };
+
+        struct Timer {
+            Recurrence const recurrence;
+            std::chrono::steady_clock::duration const period;
+            std::chrono::steady_clock::time_point deadline;
+            std::atomic<bool> canceled { false };
+            // Wheel links, guarded by the wheel lock.
+            std::shared_ptr<Timer> self;
+            Timer* next { nullptr };
+
+        private:
+            // Released as soon as it's canceled, it may own anything. Taken out while it runs.
+            std::mutex actionLock;
+            std::function<void()> action;
+
+        public:
+            Timer(std::function<void()>&& action, Recurrence const recurrence,
+                std::chrono::steady_clock::duration const period,
+                std::chrono::steady_clock::time_point const deadline) noexcept :
+                recurrence(recurrence), period(period), deadline(deadline), action(std::move(action)) {}
+
+            // Runs the action, unless canceled.
+            void fire() noexcept {
+                std::function<void()> running;
+                std::unique_lock<std::mutex> lock { actionLock };
+                if (canceled) {
+                    return;
+                }
+                running = std::move(action);
+                lock.unlock();
+                running();
+                lock.lock();
+                if (!canceled) {
+                    action = std::move(running);
+                    return;
+                }
+                // Canceled while running, so it goes once unlocked.
+                lock.unlock();
+            }
+
+            void cancel() noexcept {
+                std::function<void()> released;
+                std::lock_guard<std::mutex> lock { actionLock };
+                canceled = true;
+                released = std::move(action);
+            }
+        };
+
+    public:
+        /**
+         * Handle to a scheduled action.
+         */
+        class Handle {
+            friend class ScheduledTaskRunner;
+            friend class TaskRunner;
+
+        private:
+            std::shared_ptr<Timer> timer;
+
+            explicit Handle(std::shared_ptr<Timer> timer) noexcept : timer(std::move(timer)) {}
+
+        public:
+            /**
+             * Creates an invalid handle, with nothing scheduled.
+             */
+            Handle() noexcept = default;
+
+            /**
+             * Returns true if an action was scheduled.
+             *
+             * @return True if an action was scheduled.
+             */
+            [[nodiscard]]
+            bool isValid() const noexcept {
+                return timer != nullptr;
+            }
+
+            /**
+             * Cancels the action, so it doesn't run again.
+             *
+             * <p>The action is released right away, or once it finishes if it's running right
+             * now. Does nothing if the handle is invalid.
+             */
+            void cancel() const noexcept {
+                if (timer != nullptr) {
+                    timer->cancel();
+                }
+            }
+
+            /**
+             * Returns true if the action was canceled.
+             *
+             * @return True if the action was canceled, false if not or the handle is invalid.
+             */
+            [[nodiscard]]
+            bool isCanceled() const noexcept {
+                return (timer != nullptr) && timer->canceled;
+            }
+        };
+
+    private:
+        static constexpr size_t slotBits { 6 };
+        static constexpr size_t slotCount { 1 << slotBits };
+        static constexpr size_t levelCount { 4 };
+        static constexpr uint64_t slotMask { slotCount - 1 };
+        static constexpr uint64_t wheelSpan { uint64_t { 1 } << (slotBits * levelCount) };
+
+        struct Level {
+            std::array<Timer*, slotCount> slots {};
+            uint64_t occupied { 0 };
+        };
+
+        std::chrono::steady_clock::duration const tick;
+        std::chrono::steady_clock::time_point const origin;
+        std::array<Level, levelCount> levels;
+        // Next tick to process.
+        uint64_t currentTick { 0 };
+        // Tick the thread will wake up at, if it's waiting for one.
+        uint64_t wakeTick { UINT64_MAX };
+        size_t timerCount { 0 };
+        bool shouldExit { false };
+        mutable std::mutex wheelLock;
+        std::condition_variable wheelChangedSignal;
+        std::thread thread;
+
+    public:
+        /**
+         * Creates a runner and starts its thread.
+         *
+         * @param tick Resolution of the timers. If not positive, the clock's resolution is used.
+         */
+        explicit ScheduledTaskRunner(std::chrono::steady_clock::duration const tick = std::chrono::milliseconds(1)) noexcept :
+            tick(std::max(tick, std::chrono::steady_clock::duration { 1 })), origin(std::chrono::steady_clock::now()) {
+            thread = std::thread { [this]{ loop(); } };
+        }
+
+        ~ScheduledTaskRunner() noexcept {
+            shutdown();
+        }
+
+        /**
+         * Tests if the runner is active.
+         *
+         * @return True if the runner is active.
+         */
+        [[nodiscard]]
+        bool isActive() const noexcept {
+            std::lock_guard<std::mutex> lock { wheelLock };
+            return !shouldExit;
+        }
+
+        /**
+         * Runs an action once after a delay.
+         *
+         * @param delay Time to wait before running the action.
+         * @param action Action to run.
+         * @return A handle to the scheduled action, invalid if the runner is not active.
+         */
+        Handle schedule(std::chrono::steady_clock::duration const delay, std::function<void()> action) noexcept {
+            return add(std::move(action), Recurrence::Once, delay, std::chrono::steady_clock::duration::zero());
+        }
+
+        /**
+         * Runs an action periodically, at a fixed rate.
+         *
+         * <p>Each run is scheduled a period after the previous one was due. If runs fall behind,
+         * the missed ones run back to back.
+         *
+         * @param initialDelay Time to wait before the first run.
+         * @param period Time between the start of consecutive runs. Must be positive.
+         * @param action Action to run.
+         * @return A handle to the scheduled action, invalid if the runner is not active or the
+         *     period is not positive.
+         */
+        Handle scheduleAtFixedRate(std::chrono::steady_clock::duration const initialDelay,
+            std::chrono::steady_clock::duration const period, std::function<void()> action) noexcept {
+            if (period <= std::chrono::steady_clock::duration::zero()) {
+                return Handle {};
+            }
+            return add(std::move(action), Recurrence::FixedRate, initialDelay, period);
+        }
+
+        /**
+         * Runs an action periodically, with a fixed delay between runs.
+         *
+         * @param initialDelay Time to wait before the first run.
+         * @param delay Time between the end of a run and the start of the next. Must be positive.
+         * @param action Action to run.
+         * @return A handle to the scheduled action, invalid if the runner is not active or the
+         *     delay is not positive.
+         */
+        Handle scheduleWithFixedDelay(std::chrono::steady_clock::duration const initialDelay,
+            std::chrono::steady_clock::duration const delay, std::function<void()> action) noexcept {
+            if (delay <= std::chrono::steady_clock::duration::zero()) {
+                return Handle {};
+            }
+            return add(std::move(action), Recurrence::FixedDelay, initialDelay, delay);
+        }
+
+        /**
+         * Shuts down the runner.
+         *
+         * <p>Pending actions are dropped without running. An action running right now finishes.
+         */
+        void shutdown() noexcept {
+            std::unique_lock<std::mutex> lock { wheelLock };
+            if (shouldExit) {
+                return;
+            }
+            shouldExit = true;
+            wheelChangedSignal.notify_one();
+            lock.unlock();
+            thread.join();
+            // Drop the timers outside the lock, their actions may own anything.
+            std::array<Level, levelCount> dropped;
+            lock.lock();
+            dropped.swap(levels);
+            timerCount = 0;
+            lock.unlock();
+            for (Level& level: dropped) {
+                for (Timer* timer: level.slots) {
+                    while (timer != nullptr) {
+                        Timer* const next { timer->next };
+                        std::shared_ptr<Timer> const self { std::move(timer->self) };
+                        timer = next;
+                    }
+                }
+            }
+        }
+
+    private:
+        [[nodiscard]]
+        uint64_t toTick(std::chrono::steady_clock::time_point const time) const noexcept {
+            if (time <= origin) {
+                return 0;
+            }
+            // Rounds up, so timers never run early.
+            return static_cast<uint64_t>((time - origin + tick - std::chrono::steady_clock::duration { 1 }) / tick);
+        }
+
+        Handle add(std::function<void()>&& action, Recurrence const recurrence,
+            std::chrono::steady_clock::duration const delay, std::chrono::steady_clock::duration const period) noexcept {
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            std::shared_ptr<Timer> timer {
+                std::make_shared<Timer>(std::move(action), recurrence, period, now + delay)
+            };
+            std::lock_guard<std::mutex> lock { wheelLock };
+            if (shouldExit) {
+                return Handle {};
+            }
+            if (timerCount == 0) {
+                // The wheel is empty, so it can jump ahead to now.
+                currentTick = std::max(currentTick, toTick(now));
+            }
+            timer->self = timer;
+            uint64_t const deadlineTick { place(timer.get()) };
+            ++timerCount;
+            if (deadlineTick < wakeTick) {
+                wheelChangedSignal.notify_one();
+            }
+            return Handle { std::move(timer) };
+        }
+
+        // Links the timer into the slot for its deadline. Returns the deadline tick.
+        uint64_t place(Timer* const timer) noexcept {
+            uint64_t const deadlineTick { std::max(toTick(timer->deadline), currentTick) };
+            uint64_t const delta { deadlineTick - currentTick };
+            size_t level { 0 };
+            while ((level < levelCount - 1) && (delta >= (uint64_t { 1 } << (slotBits * (level + 1))))) {
+                ++level;
+            }
+            // Farther than the wheel spans, it will be placed again when its slot cascades.
+            uint64_t const placementTick { delta < wheelSpan ? deadlineTick : currentTick + wheelSpan - 1 };
+            size_t const slot { static_cast<size_t>((placementTick >> (slotBits * level)) & slotMask) };
+            Level& wheelLevel { levels[level] };
+            timer->next = wheelLevel.slots[slot];
+            wheelLevel.slots[slot] = timer;
+            wheelLevel.occupied |= uint64_t { 1 } << slot;
+            return deadlineTick;
+        }
+
+        [[nodiscard]]
+        Timer* takeSlot(size_t const level, size_t const slot) noexcept {
+            Level& wheelLevel { levels[level] };
+            Timer* const head { wheelLevel.slots[slot] };
+            wheelLevel.slots[slot] = nullptr;
+            wheelLevel.occupied &= ~(uint64_t { 1 } << slot);
+            return head;
+        }
+
+        // Processes currentTick, and appends due timers to the given list, so timers of earlier
+        // ticks run first when the thread fell behind.
+        void advance(Timer*& due, Timer*& dueTail) noexcept {
+            uint64_t const tickToProcess { currentTick };
+            // Cascade from the top down, every level whose lower levels just wrapped around.
+            size_t topLevel { 0 };
+            while ((topLevel < levelCount - 1) &&
+                ((tickToProcess & ((uint64_t { 1 } << (slotBits * (topLevel + 1))) - 1)) == 0)) {
+                ++topLevel;
+            }
+            for (size_t level = topLevel; level > 0; --level) {
+                Timer* timer { takeSlot(level, static_cast<size_t>((tickToProcess >> (slotBits * level)) & slotMask)) };
+                while (timer != nullptr) {
+                    Timer* const next { timer->next };
+                    if (timer->canceled) {
+                        drop(timer);
+                    } else {
+                        place(timer);
+                    }
+                    timer = next;
+                }
+            }
+            // Slots are linked newest first, so reverse it to the order timers were placed in.
+            Timer* timer { takeSlot(0, static_cast<size_t>(tickToProcess & slotMask)) };
+            Timer* const last { timer };
+            Timer* first { nullptr };
+            while (timer != nullptr) {
+                Timer* const next { timer->next };
+                timer->next = first;
+                first = timer;
+                timer = next;
+            }
+            if (first != nullptr) {
+                if (dueTail != nullptr) {
+                    dueTail->next = first;
+                } else {
+                    due = first;
+                }
+                dueTail = last;
+            }
+            ++currentTick;
+        }
+
+        void drop(Timer* const timer) noexcept {
+            --timerCount;
+            // The handle may still own it, otherwise it goes here.
+            std::shared_ptr<Timer> const self { std::move(timer->self) };
+        }
+
+        // Returns the next tick with something to do, a slot that's due or has to cascade. Only
+        // valid if there are timers.
+        [[nodiscard]]
+        uint64_t nextEventTick() const noexcept {
+            uint64_t next { UINT64_MAX };
+            for (size_t level = 0; level < levelCount; ++level) {
+                uint64_t const occupied { levels[level].occupied };
+                if (occupied == 0) {
+                    continue;
+                }
+                // A level's slots are processed as the levels below it wrap around.
+                size_t const shift { slotBits * level };
+                uint64_t const lapMask { (uint64_t { 1 } << shift) - 1 };
+                uint64_t const firstTick { (currentTick + lapMask) & ~lapMask };
+                int const firstSlot { static_cast<int>((firstTick >> shift) & slotMask) };
+                uint64_t const offset { static_cast<uint64_t>(std::countr_zero(std::rotr(occupied, firstSlot))) };
+                next = std::min(next, firstTick + (offset << shift));
+            }
+            // Nothing placed, so check again after a lap of the first level.
+            return next != UINT64_MAX ? next : (currentTick | slotMask) + 1;
+        }
+
+        void loop() noexcept {
+            std::unique_lock<std::mutex> lock { wheelLock };
+            while (!shouldExit) {
+                if (timerCount == 0) {
+                    wakeTick = UINT64_MAX;
+                    wheelChangedSignal.wait(lock);
+                    continue;
+                }
+                uint64_t const nowTick { toTick(std::chrono::steady_clock::now()) };
+                Timer* due { nullptr };
+                Timer* dueTail { nullptr };
+                while (currentTick <= nowTick) {
+                    // Skips empty ticks, which could be millions after the process was suspended.
+                    uint64_t const eventTick { nextEventTick() };
+                    if (eventTick > currentTick) {
+                        currentTick = std::min(eventTick, nowTick + 1);
+                        continue;
+                    }
+                    advance(due, dueTail);
+                }
+                if (due == nullptr) {
+                    wakeTick = nextEventTick();
+                    wheelChangedSignal.wait_until(lock, origin + tick * static_cast<int64_t>(wakeTick));
+                    continue;
+                }
+                wakeTick = 0;
+                lock.unlock();
+                run(due);
+                lock.lock();
+                reschedule(due);
+            }
+        }
+
+        void run(Timer* timer) noexcept {
+            while (timer != nullptr) {
+                timer->fire();
+                timer = timer->next;
+            }
+        }
+
+        void reschedule(Timer* timer) noexcept {
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            while (timer != nullptr) {
+                Timer* const next { timer->next };
+                if (shouldExit || timer->canceled || (timer->recurrence == Recurrence::Once)) {
+                    drop(timer);
+                } else {
+                    timer->deadline = timer->recurrence == Recurrence::FixedRate ?
+                        timer->deadline + timer->period : now + timer->period;
+                    place(timer);
+                }
+                timer = next;
+            }
+        }
+    };
+}
@@ -0,0 +1,177 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <cstddef>
+
+namespace gb {
+
+    /**
+     * Bounded queue for exactly one producer thread and one consumer thread.
+     *
+     * <p>All operations are wait-free. Each side keeps a cached copy of the other side's index,
+     * and only reads the shared one when the cached one says it's full or empty. The indices
+     * live on separate cache lines, so the two sides don't invalidate each other's lines on every
+     * operation.
+     *
+     * <p>Use a Channel if there may be more than one producer or consumer.
+     *
+     * @tparam T Value type.
+     */
+    template<typename T>
+    class SpscRingBuffer {
+    private:
+        struct Slot {
+            alignas(T) std::byte storage[sizeof(T)];
+
+            T* value() noexcept {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+        };
+
+        size_t const mask;
+        std::unique_ptr<Slot[]> const slots;
+        // Producer side.
+        alignas(64) std::atomic<size_t> tail { 0 };
+        size_t cachedHead { 0 };
+        // Consumer side.
+        alignas(64) std::atomic<size_t> head { 0 };
+        size_t cachedTail { 0 };
+
+    public:
+        /**
+         * Creates a ring buffer.
+         *
+         * @param capacity Maximum number of values in the buffer, rounded up to a power of 2.
+         */
+        explicit SpscRingBuffer(size_t const capacity) noexcept :
+            mask(std::bit_ceil(std::max(capacity, size_t { 2 })) - 1), slots(new Slot[mask + 1]) {}
+
+        SpscRingBuffer(SpscRingBuffer const&) = delete;
+
+        SpscRingBuffer& operator=(SpscRingBuffer const&) = delete;
+
+        ~SpscRingBuffer() noexcept {
+            size_t const end { tail.load(std::memory_order_relaxed) };
+            for (size_t i = head.load(std::memory_order_relaxed); i != end; ++i) {
+                slots[i & mask].value()->~T();
+            }
+        }
+
+        /**
+         * Returns the maximum number of values in the buffer.
+         *
+         * @return The maximum number of values in the buffer.
+         */
+        [[nodiscard]]
+        size_t capacity() const noexcept {
+            return mask + 1;
+        }
+
+        /**
+         * Returns the number of values in the buffer. It may be stale by the time it returns.
+         *
+         * @return The number of values in the buffer.
+         */
+        [[nodiscard]]
+        size_t size() const noexcept {
+            size_t const currentHead { head.load(std::memory_order_acquire) };
+            return tail.load(std::memory_order_acquire) - currentHead;
+        }
+
+        /**
+         * Pushes a value if there is room. Only call from the producer thread.
+         *
+         * <p>The value is only moved from if it's pushed.
+         *
+         * @tparam U Value type.
+         * @param value Value to push.
+         * @return True if pushed, false if the buffer is full.
+         */
+        template<typename U>
+        bool tryPush(U&& value) noexcept {
+            size_t const currentTail { tail.load(std::memory_order_relaxed) };
+            if (currentTail - cachedHead > mask) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (currentTail - cachedHead > mask) {
+                    return false;
+                }
+            }
+            new (slots[currentTail & mask].storage) T(std::forward<U>(value));
+            tail.store(currentTail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Pushes as many values as there is room for, moving them in. Only call from the producer
+         * thread.
+         *
+         * @param values Values to push.
+         * @return The number of values pushed, from the front of the given ones.
+         */
+        size_t tryPushBatch(std::span<T> const values) noexcept {
+            size_t const currentTail { tail.load(std::memory_order_relaxed) };
+            size_t room { mask + 1 - (currentTail - cachedHead) };
+            if (room < values.size()) {
+                cachedHead = head.load(std::memory_order_acquire);
+                room = mask + 1 - (currentTail - cachedHead);
+            }
+            size_t const count { std::min(room, values.size()) };
+            for (size_t i = 0; i < count; ++i) {
+                new (slots[(currentTail + i) & mask].storage) T(std::move(values[i]));
+            }
+            tail.store(currentTail + count, std::memory_order_release);
+            return count;
+        }
+
+        /**
+         * Pops a value if there is one. Only call from the consumer thread.
+         *
+         * @return The value, or empty if the buffer is empty.
+         */
+        std::optional<T> tryPop() noexcept {
+            size_t const currentHead { head.load(std::memory_order_relaxed) };
+            if (currentHead == cachedTail) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (currentHead == cachedTail) {
+                    return std::nullopt;
+                }
+            }
+            T* const value { slots[currentHead & mask].value() };
+            std::optional<T> result { std::move(*value) };
+            value->~T();
+            head.store(currentHead + 1, std::memory_order_release);
+            return result;
+        }
+
+        /**
+         * Pops as many values as there are and fit, moving them out. Only call from the consumer
+         * thread.
+         *
+         * @param values Where to move the values to.
+         * @return The number of values popped, into the front of the given ones.
+         */
+        size_t tryPopBatch(std::span<T> const values) noexcept {
+            size_t const currentHead { head.load(std::memory_order_relaxed) };
+            if (cachedTail - currentHead < values.size()) {
+                cachedTail = tail.load(std::memory_order_acquire);
+            }
+            size_t const count { std::min(cachedTail - currentHead, values.size()) };
+            for (size_t i = 0; i < count; ++i) {
+                T* const value { slots[(currentHead + i) & mask].value() };
+                values[i] = std::move(*value);
+                value->~T();
+            }
+            head.store(currentHead + count, std::memory_order_release);
+            return count;
+        }
+    };
+}
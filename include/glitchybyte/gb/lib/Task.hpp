@@ -3,9 +3,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <condition_variable>
 #include <thread>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <chrono>
+#include <cstdint>
 
 namespace gb {
 
@@ -17,6 +23,11 @@ namespace gb {
      */
     class Task {
         friend class TaskRunner;
+        friend class TaskGraph;
+        friend class TaskGroup;
+
+        template<typename T>
+        friend class Channel;
 
     public:
         /**
@@ -29,12 +40,66 @@ namespace gb {
             Finished
         };
 
+        /**
+         * Task priority classes.
+         *
+         * <p>Pooled runners dispatch queued tasks of higher priority first.
+         */
+        enum class Priority : int {
+            Low,
+            Normal,
+            High
+        };
+
+        /**
+         * Node affinity of a task that may run on any NUMA node.
+         */
+        static constexpr size_t anyNode { SIZE_MAX };
+
+        /**
+         * Timings of a task, recorded by runners with metrics enabled.
+         */
+        struct Metrics {
+            /**
+             * Time from being started on the runner to its action being run.
+             */
+            std::chrono::nanoseconds queueLatency { 0 };
+
+            /**
+             * Time from its action being run to it calling started(), or 0 if it didn't.
+             */
+            std::chrono::nanoseconds startLatency { 0 };
+
+            /**
+             * Time from its action being run to it being done.
+             */
+            std::chrono::nanoseconds runTime { 0 };
+
+            /**
+             * Time from it being canceled to it being done, or 0 if it wasn't canceled.
+             */
+            std::chrono::nanoseconds cancelLatency { 0 };
+        };
+
     private:
+        // Stop callback that requests a stop on another source.
+        struct StopForwarder {
+            std::stop_source source;
+
+            void operator()() noexcept {
+                source.request_stop();
+            }
+        };
+
         static inline std::atomic<uint64_t> nextTaskId { 0 };
+        // Task running on this thread, set by the runner.
+        static inline thread_local Task* currentTask { nullptr };
 
     protected:
         /**
-         * Lock for any state related operation.
+         * Lock for state related operations of implementations.
+         *
+         * <p>The task's own state transitions are lock-free and don't use it.
          */
         std::mutex stateLock;
 
@@ -43,8 +108,39 @@ namespace gb {
         std::thread thread;
         TaskRunner* runner { nullptr };
         std::atomic<State> state { State::Created };
-        std::condition_variable stateChangedSignal;
         std::atomic<bool> _shouldCancel { false };
+        std::atomic<Priority> priority { Priority::Normal };
+        std::atomic<size_t> nodeAffinity { anyNode };
+        std::atomic<bool> registered { false };
+        std::shared_ptr<Task> registeredSelf;
+        Task* registryPrevious { nullptr };
+        Task* registryNext { nullptr };
+        // Called by the runner once the task is done, set before it's started.
+        std::function<void()> stopHook;
+        // Enclosing group's cancel flag and the task that owns the group, if any.
+        std::atomic<bool> const* scopeCanceled { nullptr };
+        Task const* scopeOwner { nullptr };
+        std::stop_token scopeStopToken;
+        // Created on first request for a stop token.
+        std::mutex stopSourceLock;
+        std::atomic<bool> hasStopSource { false };
+        std::stop_source stopSource { std::nostopstate };
+        std::optional<std::stop_callback<StopForwarder>> scopeStopCallback;
+        // Timestamps, only taken if the runner records metrics.
+        std::atomic<bool> recordsMetrics { false };
+        std::chrono::steady_clock::time_point queuedAt;
+        std::chrono::steady_clock::time_point runAt;
+        std::chrono::steady_clock::time_point startedAt;
+        std::atomic<std::chrono::steady_clock::rep> cancelRequestedAt { 0 };
+        Metrics metrics;
+        // Id in the runner's trace, or 0 if the runner doesn't trace.
+        uint64_t traceId { 0 };
+        // True while it holds a slot of a bounded runner.
+        bool holdsAdmission { false };
+        // Last sign of progress while running, or 0 if not running. The last one reported as
+        // stuck is only touched by the runner's watchdog.
+        std::atomic<std::chrono::steady_clock::rep> lastHeartbeat { 0 };
+        std::chrono::steady_clock::rep reportedHeartbeat { 0 };
 
     public:
         /**
@@ -54,6 +150,16 @@ namespace gb {
 
         virtual ~Task() noexcept = default;
 
+        /**
+         * Returns the unique id of the task.
+         *
+         * @return The unique id of the task.
+         */
+        [[nodiscard]]
+        uint64_t getId() const noexcept {
+            return taskId;
+        }
+
         /**
          * Returns the current state of the task, as of the time of calling this method.
          *
@@ -65,25 +171,125 @@ namespace gb {
             return state;
         }
 
+        /**
+         * Returns the priority of the task.
+         *
+         * @return The priority of the task.
+         */
+        [[nodiscard]]
+        Priority getPriority() const noexcept {
+            return priority.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Sets the priority of the task.
+         *
+         * <p>It takes effect the next time the task is queued, usually when it's started.
+         *
+         * @param newPriority New priority.
+         */
+        void setPriority(Priority const newPriority) noexcept {
+            priority.store(newPriority, std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the NUMA node the task prefers to run on.
+         *
+         * @return The NUMA node the task prefers to run on, or anyNode.
+         */
+        [[nodiscard]]
+        size_t getNodeAffinity() const noexcept {
+            return nodeAffinity.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Sets the NUMA node the task prefers to run on.
+         *
+         * <p>It's a hint for runners with workers placed by node, and ignored by others. It takes
+         * effect the next time the task is queued, usually when it's started.
+         *
+         * @param node NUMA node, or anyNode.
+         */
+        void setNodeAffinity(size_t const node) noexcept {
+            nodeAffinity.store(node, std::memory_order_relaxed);
+        }
+
         /**
          * Signals the task to cancel.
          *
          * <p>It's up to the task itself to check for its cancellation and needing to exit.
+         *
+         * <p>A task that has not started yet will see the cancellation as soon as it starts.
          */
         void cancel() noexcept {
-            std::lock_guard<std::mutex> lock { stateLock };
-            if (state != State::Started) {
+            if (isStopped()) {
                 return;
             }
             _shouldCancel = true;
+            if (recordsMetrics.load(std::memory_order_relaxed)) {
+                std::chrono::steady_clock::rep notRequested { 0 };
+                cancelRequestedAt.compare_exchange_strong(notRequested,
+                    std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            }
+            // Pairs with getStopToken, so either it sees the flag or we see its source.
+            if (!hasStopSource) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock { stopSourceLock };
+            std::stop_source source { stopSource };
+            lock.unlock();
+            // Stop callbacks run here, outside the lock.
+            source.request_stop();
+        }
+
+        /**
+         * Returns a stop token that gets a stop request when the task is canceled.
+         *
+         * <p>Use it to wake blocking waits on cancellation, like a std::condition_variable_any wait,
+         * or register a std::stop_callback with it to abort a blocking operation.
+         *
+         * <p>A task started in a TaskGroup also gets a stop request when the group or its owner
+         * is canceled.
+         *
+         * @return A stop token for the task.
+         */
+        [[nodiscard]]
+        std::stop_token getStopToken() noexcept {
+            std::unique_lock<std::mutex> lock { stopSourceLock };
+            if (!hasStopSource) {
+                stopSource = std::stop_source {};
+                hasStopSource = true;
+                if (scopeStopToken.stop_possible()) {
+                    // Runs right away if the scope was already stopped.
+                    scopeStopCallback.emplace(scopeStopToken, StopForwarder { stopSource });
+                }
+            }
+            std::stop_source source { stopSource };
+            lock.unlock();
+            if (_shouldCancel) {
+                source.request_stop();
+            }
+            return source.get_token();
+        }
+
+        /**
+         * Blocks the calling thread until the task signals it has started.
+         *
+         * <p>Use it to wait for readiness of a task started with TaskRunner::startAsync.
+         */
+        void awaitStart() const noexcept {
+            state.wait(State::Created);
         }
 
         /**
          * Blocks the calling thread until the task stops, either by cancellation or by finishing.
          */
-        void awaitStop() noexcept {
-            std::unique_lock<std::mutex> lock { stateLock };
-            stateChangedSignal.wait(lock, [this]{ return isStopped(); });
+        void awaitStop() const noexcept {
+            State currentState { state };
+            while ((currentState != State::Canceled) && (currentState != State::Finished)) {
+                state.wait(currentState);
+                currentState = state;
+            }
         }
 
         /**
@@ -98,6 +304,42 @@ namespace gb {
             return (currentState == State::Canceled) || (currentState == State::Finished);
         }
 
+        /**
+         * Signals the task is making progress.
+         *
+         * <p>Long running actions should call it more often than the watchdog threshold of their
+         * runner, so they are not reported as stuck. It's a single relaxed store, cheap enough
+         * to call in a tight loop.
+         */
+        void heartbeat() noexcept {
+            lastHeartbeat.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the time of the task's last heartbeat.
+         *
+         * <p>Runners with a watchdog count the task beginning to run as a heartbeat.
+         *
+         * @return The time of the last heartbeat, or the clock's epoch if there was none or the
+         *     task is not running.
+         */
+        [[nodiscard]]
+        std::chrono::steady_clock::time_point getLastHeartbeat() const noexcept {
+            return std::chrono::steady_clock::time_point { std::chrono::steady_clock::duration { lastHeartbeat.load(std::memory_order_relaxed) } };
+        }
+
+        /**
+         * Returns the timings of the task.
+         *
+         * <p>Only valid once the task has stopped, and if its runner records metrics.
+         *
+         * @return The timings of the task.
+         */
+        [[nodiscard]]
+        Metrics const& getMetrics() const noexcept {
+            return metrics;
+        }
+
     protected:
         /**
          * Actual action that is executed on its own thread.
@@ -124,12 +366,10 @@ namespace gb {
          * <p>It MUST be called within action by implementations.
          */
         void started() noexcept {
-            std::lock_guard<std::mutex> lock { stateLock };
-            if (state != State::Created) {
-                return;
+            if (recordsMetrics.load(std::memory_order_relaxed)) {
+                startedAt = std::chrono::steady_clock::now();
             }
-            state = State::Started;
-            stateChangedSignal.notify_all();
+            transition(State::Created, State::Started);
         }
 
         /**
@@ -137,44 +377,90 @@ namespace gb {
          *
          * <p>Long running action implementations should check this periodically and exit when requested.
          *
+         * <p>A task started in a TaskGroup is also canceled when the group or its owner is.
+         *
          * @return True if the task was canceled and should exit.
          */
         [[nodiscard]]
         bool shouldCancel() const noexcept {
-            return _shouldCancel;
+            return isCancelRequested();
+        }
+
+        // Stops a task that will never run again, like one left on a simulated runner when it
+        // shuts down, and wakes up whoever awaits it.
+        virtual void abandon() noexcept {
+            transition(State::Created, State::Canceled);
+            transition(State::Started, State::Canceled);
+            if (stopHook) {
+                stopHook();
+            }
         }
 
     private:
+        // Runs the action on a pooled runner's worker. Returns false if the action suspended
+        // and the task will be enqueued again when resumed, instead of being done.
+        virtual bool run() noexcept {
+            action();
+            return true;
+        }
+
+        // True if run may return before the action is done.
+        [[nodiscard]]
+        virtual bool canSuspend() const noexcept {
+            return false;
+        }
+
+        // True if this task, or any enclosing group or its owner, was canceled.
+        [[nodiscard]]
+        bool isCancelRequested() const noexcept {
+            for (Task const* task = this; task != nullptr; task = task->scopeOwner) {
+                if (task->_shouldCancel) {
+                    return true;
+                }
+                if ((task->scopeCanceled != nullptr) && *task->scopeCanceled) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Links the enclosing group's stop token, also to a stop source already handed out.
+        void setScopeStopToken(std::stop_token const& token) noexcept {
+            std::lock_guard<std::mutex> lock { stopSourceLock };
+            scopeStopToken = token;
+            if (hasStopSource && scopeStopToken.stop_possible()) {
+                // Runs right away if the scope was already stopped.
+                scopeStopCallback.emplace(scopeStopToken, StopForwarder { stopSource });
+            }
+        }
+
         void setTaskRunner(TaskRunner* const newRunner) noexcept {
             runner = newRunner;
         }
 
         void canceled() noexcept {
-            std::lock_guard<std::mutex> lock { stateLock };
-            if (state != State::Started) {
-                return;
-            }
-            state = State::Canceled;
-            stateChangedSignal.notify_all();
+            transition(State::Started, State::Canceled);
         }
 
         void finished() noexcept {
-            std::lock_guard<std::mutex> lock { stateLock };
-            if (state != State::Started) {
-                return;
+            transition(State::Started, State::Finished);
+            if (stopHook) {
+                stopHook();
             }
-            state = State::Finished;
-            stateChangedSignal.notify_all();
         }
 
-        void awaitState(State const desiredState) noexcept {
-            std::unique_lock<std::mutex> lock { stateLock };
-            stateChangedSignal.wait(lock, [this, desiredState]{ return state == desiredState; });
+        void transition(State from, State const to) noexcept {
+            if (state.compare_exchange_strong(from, to)) {
+                state.notify_all();
+            }
         }
 
-        void awaitStart() noexcept {
-            std::unique_lock<std::mutex> lock { stateLock };
-            stateChangedSignal.wait(lock, [this]{ return state != State::Created; });
+        void awaitState(State const desiredState) const noexcept {
+            State currentState { state };
+            while (currentState != desiredState) {
+                state.wait(currentState);
+                currentState = state;
+            }
         }
     };
 }
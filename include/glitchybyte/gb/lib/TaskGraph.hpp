@@ -0,0 +1,301 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "Task.hpp"
+#include "TaskRunner.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <span>
+#include <initializer_list>
+
+namespace gb {
+
+    /**
+     * A directed acyclic graph of tasks, where each task starts as soon as all the tasks it
+     * depends on have stopped.
+     *
+     * <p>Nodes can only depend on nodes added before them, so the graph can't have cycles.
+     *
+     * <p>Nodes on the critical path, the longest chain of dependencies, run at high priority if
+     * they were normal priority, and are set back to normal priority once they stop. And when
+     * several nodes become ready at once, those with the longest chain of dependents ahead of them
+     * are started first.
+     *
+     * <p>A task can only belong to one graph, and must not be started by other means.
+     */
+    class TaskGraph {
+    private:
+        struct Node {
+            std::shared_ptr<Task> const task;
+            std::vector<size_t> successors;
+            size_t predecessorCount { 0 };
+            // Length of the longest chain of nodes starting at this one.
+            size_t rank { 1 };
+            bool isCritical { false };
+            // Set when started, and read once stopped.
+            bool raisedPriority { false };
+            std::atomic<size_t> pendingPredecessors { 0 };
+            std::atomic<bool> skipped { false };
+
+            explicit Node(std::shared_ptr<Task> task) noexcept : task(std::move(task)) {}
+        };
+
+        struct Graph : public std::enable_shared_from_this<Graph> {
+            std::vector<std::unique_ptr<Node>> nodes;
+            TaskRunner* runner { nullptr };
+            std::atomic<size_t> remaining { 0 };
+        };
+
+        std::shared_ptr<Graph> graph { std::make_shared<Graph>() };
+        bool started { false };
+
+    public:
+        TaskGraph() noexcept = default;
+
+        TaskGraph(TaskGraph const&) = delete;
+
+        TaskGraph& operator=(TaskGraph const&) = delete;
+
+        /**
+         * Cancels the graph and awaits for all of its tasks to stop.
+         */
+        ~TaskGraph() noexcept {
+            if (started) {
+                cancel();
+                awaitStop();
+            }
+        }
+
+        /**
+         * Adds a task to the graph.
+         *
+         * <p>Must be called before the graph is started.
+         *
+         * @param task Task to add.
+         * @param dependencies Nodes that must stop before this one starts.
+         * @return The node of the task.
+         */
+        size_t add(std::shared_ptr<Task> const& task, std::initializer_list<size_t> const dependencies = {}) noexcept {
+            return add(task, std::span<size_t const> { dependencies.begin(), dependencies.size() });
+        }
+
+        /**
+         * Adds a task to the graph.
+         *
+         * <p>Must be called before the graph is started.
+         *
+         * @param task Task to add.
+         * @param dependencies Nodes that must stop before this one starts. Nodes not yet in the
+         *     graph are ignored.
+         * @return The node of the task.
+         */
+        size_t add(std::shared_ptr<Task> const& task, std::span<size_t const> const dependencies) noexcept {
+            size_t const index { graph->nodes.size() };
+            std::unique_ptr<Node> node { std::make_unique<Node>(task) };
+            for (size_t const dependency: dependencies) {
+                if (dependency >= index) {
+                    continue;
+                }
+                std::vector<size_t>& successors { graph->nodes[dependency]->successors };
+                if (std::ranges::find(successors, index) != successors.end()) {
+                    continue;
+                }
+                successors.push_back(index);
+                ++node->predecessorCount;
+            }
+            graph->nodes.push_back(std::move(node));
+            return index;
+        }
+
+        /**
+         * Returns the number of nodes in the graph.
+         *
+         * @return The number of nodes in the graph.
+         */
+        [[nodiscard]]
+        size_t size() const noexcept {
+            return graph->nodes.size();
+        }
+
+        /**
+         * Returns the task of a node.
+         *
+         * @param node Node.
+         * @return The task of the node.
+         */
+        [[nodiscard]]
+        std::shared_ptr<Task> const& getTask(size_t const node) const noexcept {
+            return graph->nodes[node]->task;
+        }
+
+        /**
+         * Starts the graph on the given runner.
+         *
+         * <p>Tasks that fail to start are skipped, along with all the nodes that depend on them,
+         * directly or not.
+         *
+         * @param runner Runner for the tasks.
+         * @return True if the graph was started.
+         */
+        bool start(TaskRunner& runner) noexcept {
+            if (started || !runner.isActive()) {
+                return false;
+            }
+            started = true;
+            std::vector<std::unique_ptr<Node>>& nodes { graph->nodes };
+            graph->runner = &runner;
+            graph->remaining = nodes.size();
+            if (nodes.empty()) {
+                return true;
+            }
+            // Nodes are in topological order, so ranks can be found from the sinks back.
+            for (size_t i = nodes.size(); i-- > 0;) {
+                for (size_t const successor: nodes[i]->successors) {
+                    nodes[i]->rank = std::max(nodes[i]->rank, nodes[successor]->rank + 1);
+                }
+            }
+            // And the longest chain ending at each node from the sources forward.
+            std::vector<size_t> depth(nodes.size(), 1);
+            size_t criticalLength { 0 };
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                for (size_t const successor: nodes[i]->successors) {
+                    depth[successor] = std::max(depth[successor], depth[i] + 1);
+                }
+                criticalLength = std::max(criticalLength, nodes[i]->rank);
+            }
+            std::vector<size_t> ready;
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                Node& node { *nodes[i] };
+                node.isCritical = depth[i] + node.rank - 1 == criticalLength;
+                node.pendingPredecessors = node.predecessorCount;
+                if (node.predecessorCount == 0) {
+                    ready.push_back(i);
+                }
+            }
+            launch(*graph, std::move(ready));
+            return true;
+        }
+
+        /**
+         * Cancels all the tasks in the graph.
+         *
+         * <p>Tasks not yet started are skipped.
+         */
+        void cancel() noexcept {
+            for (auto const& node: graph->nodes) {
+                node->skipped = true;
+                node->task->cancel();
+            }
+        }
+
+        /**
+         * Cancels a node and all the nodes that depend on it, directly or not.
+         *
+         * <p>Tasks not yet started are skipped.
+         *
+         * @param node Node to cancel.
+         */
+        void cancel(size_t const node) noexcept {
+            skip(*graph, node);
+        }
+
+        /**
+         * Blocks the calling thread until all the tasks in the graph have stopped or were skipped.
+         */
+        void awaitStop() const noexcept {
+            for (size_t current = graph->remaining; current > 0; current = graph->remaining) {
+                graph->remaining.wait(current);
+            }
+        }
+
+        /**
+         * Tests if all the tasks in the graph have stopped or were skipped.
+         *
+         * @return True if the graph has stopped.
+         */
+        [[nodiscard]]
+        bool isStopped() const noexcept {
+            return started && (graph->remaining == 0);
+        }
+
+    private:
+        static void complete(Graph& graph, size_t const index) noexcept {
+            Node& node { *graph.nodes[index] };
+            if (node.raisedPriority) {
+                // Unless it was changed meanwhile.
+                Task::Priority raised { Task::Priority::High };
+                node.task->priority.compare_exchange_strong(raised, Task::Priority::Normal, std::memory_order_relaxed);
+            }
+            std::vector<size_t> ready;
+            release(graph, index, ready);
+            launch(graph, std::move(ready));
+        }
+
+        // Cancels a node and all the nodes that depend on it, directly or not.
+        static void skip(Graph& graph, size_t const index) noexcept {
+            std::vector<size_t> toSkip { index };
+            while (!toSkip.empty()) {
+                Node& current { *graph.nodes[toSkip.back()] };
+                toSkip.pop_back();
+                if (current.skipped.exchange(true)) {
+                    continue;
+                }
+                current.task->cancel();
+                toSkip.insert(toSkip.end(), current.successors.begin(), current.successors.end());
+            }
+        }
+
+        // Links the task to the graph, only once the runner has claimed it.
+        static bool startNode(Graph& graph, size_t const index) noexcept {
+            Node& node { *graph.nodes[index] };
+            return graph.runner->startTask(node.task, false, false, [&graph, &node, index](Task& task) {
+                if (node.isCritical) {
+                    Task::Priority normal { Task::Priority::Normal };
+                    node.raisedPriority = task.priority.compare_exchange_strong(normal, Task::Priority::High, std::memory_order_relaxed);
+                }
+                task.stopHook = [weakGraph = graph.weak_from_this(), index]{
+                    // Keeps the graph alive until done, even if awaitStop returns meanwhile.
+                    std::shared_ptr<Graph> const graph { weakGraph.lock() };
+                    if (graph) {
+                        complete(*graph, index);
+                    }
+                };
+            });
+        }
+
+        // Marks a node as stopped, and collects the dependents that became ready.
+        static void release(Graph& graph, size_t const index, std::vector<size_t>& ready) noexcept {
+            for (size_t const successor: graph.nodes[index]->successors) {
+                if (--graph.nodes[successor]->pendingPredecessors == 0) {
+                    ready.push_back(successor);
+                }
+            }
+            if (--graph.remaining == 0) {
+                graph.remaining.notify_all();
+            }
+        }
+
+        static void launch(Graph& graph, std::vector<size_t>&& ready) noexcept {
+            while (!ready.empty()) {
+                // Longest chain ahead first.
+                std::ranges::sort(ready, [&graph](size_t const a, size_t const b) {
+                    return graph.nodes[a]->rank < graph.nodes[b]->rank;
+                });
+                std::vector<size_t> batch;
+                batch.swap(ready);
+                for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+                    if (graph.nodes[*it]->skipped) {
+                        release(graph, *it, ready);
+                    } else if (!startNode(graph, *it)) {
+                        skip(graph, *it);
+                        release(graph, *it, ready);
+                    }
+                }
+            }
+        }
+    };
+}
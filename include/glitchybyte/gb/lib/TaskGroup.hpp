@@ -0,0 +1,164 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "Task.hpp"
+#include "TaskRunner.hpp"
+#include "Future.hpp"
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <optional>
+#include <stop_token>
+
+namespace gb {
+
+    /**
+     * Scope for child tasks, which can't outlive it.
+     *
+     * <p>Open it within a task's action to spawn children on the same runner. Leaving the scope
+     * awaits for all children to stop. Canceling the group, or the task that opened it, cancels
+     * the children. They see it through shouldCancel without anyone taking a lock or visiting them,
+     * and their stop tokens get a stop request.
+     *
+     * <p>While it waits on a worker of a pooled runner, the worker runs queued tasks, so a group
+     * never deadlocks a pool by waiting on children that need its worker.
+     *
+     * <p>A task can only belong to one group, and must not be in a TaskGraph.
+     */
+    class TaskGroup {
+    private:
+        struct State {
+            std::atomic<bool> canceled { false };
+            std::atomic<size_t> pending { 0 };
+            std::stop_source stopSource;
+            // Forwards the owner's stop requests to the children's stop tokens.
+            std::optional<std::stop_callback<Task::StopForwarder>> ownerStopCallback;
+        };
+
+        TaskRunner* const runner;
+        Task* const owner;
+        std::shared_ptr<State> const state { std::make_shared<State>() };
+
+    public:
+        /**
+         * Opens a group for children of the task running on the calling thread, on its runner.
+         *
+         * <p>If not called from within a task, nothing can be started in the group.
+         */
+        TaskGroup() noexcept :
+            runner(Task::currentTask != nullptr ? Task::currentTask->runner : nullptr), owner(Task::currentTask) {
+            linkOwner();
+        }
+
+        /**
+         * Opens a group for children on the given runner.
+         *
+         * <p>If called from within a task, the group is canceled when the task is.
+         *
+         * @param runner Runner for the children.
+         */
+        explicit TaskGroup(TaskRunner& runner) noexcept : runner(&runner), owner(Task::currentTask) {
+            linkOwner();
+        }
+
+        TaskGroup(TaskGroup const&) = delete;
+
+        TaskGroup& operator=(TaskGroup const&) = delete;
+
+        /**
+         * Awaits for all children to stop.
+         */
+        ~TaskGroup() noexcept {
+            wait();
+        }
+
+        /**
+         * Starts a child task.
+         *
+         * <p>This method does not block.
+         *
+         * @param task Task to start. It must not have been started before.
+         * @return True if the task was started, false if it's already started, even if it hasn't
+         *     signaled so yet, or the runner didn't accept it.
+         */
+        bool start(std::shared_ptr<Task> const& task) noexcept {
+            if ((runner == nullptr) || (task->getState() != Task::State::Created)) {
+                return false;
+            }
+            // The runner only lets us link the task once it has claimed it, so a task already
+            // queued or running is left untouched.
+            return runner->startTask(task, false, false, [this](Task& child) {
+                child.scopeCanceled = &state->canceled;
+                child.scopeOwner = owner;
+                child.setScopeStopToken(state->stopSource.get_token());
+                child.stopHook = [state = state]{
+                    if (--state->pending == 0) {
+                        state->pending.notify_all();
+                    }
+                };
+                ++state->pending;
+            });
+        }
+
+        /**
+         * Runs a function as a child task.
+         *
+         * @tparam F Function type.
+         * @param fn Function to run.
+         * @return A future for the result of the function, invalid if it couldn't be started.
+         */
+        template<typename F>
+        auto submit(F&& fn) noexcept {
+            using Fn = std::decay_t<F>;
+            using R = std::invoke_result_t<Fn&>;
+            std::shared_ptr<TaskRunner::CallableTask<Fn, R>> const task { TaskRunner::makeCallableTask(std::forward<F>(fn)) };
+            if (!start(task)) {
+                return Future<R> {};
+            }
+            return Future<R> { task };
+        }
+
+        /**
+         * Cancels all children, including the ones started from now on.
+         */
+        void cancel() noexcept {
+            state->canceled = true;
+            state->stopSource.request_stop();
+        }
+
+        /**
+         * Tests if the group, or the task that opened it, was canceled.
+         *
+         * @return True if the group was canceled.
+         */
+        [[nodiscard]]
+        bool isCanceled() const noexcept {
+            return state->canceled || ((owner != nullptr) && owner->isCancelRequested());
+        }
+
+        /**
+         * Blocks the calling thread until all children have stopped.
+         */
+        void wait() noexcept {
+            while (true) {
+                size_t const pending { state->pending };
+                if (pending == 0) {
+                    return;
+                }
+                if ((runner != nullptr) && runner->runQueuedTask()) {
+                    continue;
+                }
+                state->pending.wait(pending);
+            }
+        }
+
+    private:
+        void linkOwner() noexcept {
+            if (owner != nullptr) {
+                state->ownerStopCallback.emplace(owner->getStopToken(), Task::StopForwarder { state->stopSource });
+            }
+        }
+    };
+}
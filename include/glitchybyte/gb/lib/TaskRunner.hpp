@@ -4,61 +4,601 @@
 #pragma once
 
 #include "Task.hpp"
+#include "Future.hpp"
+#include "ScheduledTaskRunner.hpp"
+#include "Histogram.hpp"
+#include "TraceRecorder.hpp"
+#include "CpuTopology.hpp"
+#include "PoolAllocator.hpp"
 #include <vector>
-#include <set>
+#include <deque>
+#include <array>
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <span>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <map>
+#include <random>
 
 namespace gb {
 
+    class CoTaskBase;
+
+    template<typename T>
+    class CoTask;
+
     /**
      * Task runner facility to run tasks in their own threads.
      *
+     * <p>Alternatively, a runner can be created with a fixed pool of worker threads. In that mode
+     * threads are reused and each task's action is executed on whichever worker picks it up.
+     *
      * <p>Note that start method will block until the task signals it has started. This is by design
-     * to ensure a task is ready to accept input, for example.
+     * to ensure a task is ready to accept input, for example. Use startAsync to return right away
+     * and only wait for readiness when needed.
+     *
+     * <p>For tests, a runner can be simulated instead. It runs tasks one at a time on the thread
+     * that drives it, in an order picked by a seeded random generator, with timers on a virtual
+     * clock. The same seed always gives the same interleaving.
      */
     class TaskRunner {
+        friend class CoTaskBase;
+        friend class TaskGroup;
+        friend class TaskGraph;
+
+    public:
+        /**
+         * How workers of a pool are placed on CPUs.
+         */
+        enum class WorkerAffinity : int {
+            /**
+             * Workers run on any CPU.
+             */
+            None,
+
+            /**
+             * Workers are spread evenly across NUMA nodes, each pinned to the CPUs of its node.
+             */
+            Node,
+
+            /**
+             * Workers are spread evenly across NUMA nodes, each pinned to a single CPU of its node.
+             */
+            Cpu
+        };
+
+        /**
+         * What to do with a task started while the runner is full.
+         */
+        enum class OverflowPolicy : int {
+            /**
+             * The starting thread blocks until there is room. A worker of the runner runs queued
+             * tasks meanwhile.
+             */
+            Block,
+
+            /**
+             * The task is not started, and start returns false.
+             */
+            Reject,
+
+            /**
+             * The starting thread runs the task itself, before start returns. Without a pool,
+             * nothing would resume a coroutine task suspended on the starting thread, so it
+             * gets its own thread instead, past the limit.
+             */
+            CallerRuns,
+
+            /**
+             * The oldest queued task of the lowest priority is dropped from the queue to make
+             * room. It's canceled without running, and a submitted function's future is
+             * canceled. Without a pool nothing is queued, so tasks are rejected instead.
+             */
+            DropOldest
+        };
+
+        /**
+         * Counts of what happened to tasks started on a bounded runner.
+         */
+        struct AdmissionStats {
+            /**
+             * Tasks admitted, including those admitted after blocking or dropping others.
+             */
+            uint64_t admitted { 0 };
+
+            /**
+             * Tasks whose starting thread had to block.
+             */
+            uint64_t blocked { 0 };
+
+            /**
+             * Tasks not started.
+             */
+            uint64_t rejected { 0 };
+
+            /**
+             * Tasks run by their starting thread, or by their own thread past the limit.
+             */
+            uint64_t ranByCaller { 0 };
+
+            /**
+             * Queued tasks canceled to make room.
+             */
+            uint64_t dropped { 0 };
+        };
+
+        /**
+         * Options for a task runner that runs each task in its own thread.
+         */
+        struct ThreadOptions {
+            /**
+             * Maximum number of task threads. If 0, there is no limit.
+             */
+            size_t maxThreads { 0 };
+
+            /**
+             * What to do with a task started while there are maxThreads task threads.
+             */
+            OverflowPolicy overflowPolicy { OverflowPolicy::Block };
+        };
+
+        /**
+         * Options for a task runner with a pool of worker threads.
+         */
+        struct Options {
+            /**
+             * Number of worker threads. If 0, the hardware concurrency is used.
+             */
+            size_t workerCount { 0 };
+
+            /**
+             * If true, each worker has its own task queue and idle workers steal from busy ones.
+             *
+             * <p>Tasks started from within a running task's action go to the local queue of the
+             * worker running it. start may then run the task on that worker, see start.
+             */
+            bool workStealing { false };
+
+            /**
+             * Time a queued task waits to be dispatched as if it had one priority class higher.
+             *
+             * <p>This keeps lower priority tasks from starving. If 0, there is no aging.
+             */
+            std::chrono::milliseconds priorityAging { 100 };
+
+            /**
+             * Maximum number of worker threads.
+             *
+             * <p>If greater than workerCount, the pool is elastic. It starts with workerCount
+             * workers, and adds workers while more tasks are queued than there are workers.
+             * Workers idle for idleTimeout are retired, down to workerCount.
+             */
+            size_t maxWorkerCount { 0 };
+
+            /**
+             * Time an elastic pool's worker waits for a task before it is retired.
+             */
+            std::chrono::milliseconds idleTimeout { 10000 };
+
+            /**
+             * Time an elastic pool's worker can be running the same task before it counts as
+             * blocked.
+             *
+             * <p>While tasks are queued, no worker is idle, and a worker is blocked, a worker is
+             * added to make up for it. If 0, blocked workers are not made up for.
+             */
+            std::chrono::milliseconds blockedWorkerTimeout { 100 };
+
+            /**
+             * How workers are placed on CPUs.
+             *
+             * <p>When placed by node, tasks with a node affinity are queued for the workers of
+             * that node, ahead of other tasks. Workers of other nodes only take them while none of
+             * the node's workers is idle.
+             */
+            WorkerAffinity workerAffinity { WorkerAffinity::None };
+
+            /**
+             * Topology to place workers on. If null, the machine's is detected.
+             *
+             * <p>Only read while the runner is created.
+             */
+            CpuTopology const* topology { nullptr };
+
+            /**
+             * Maximum number of started tasks waiting to run. If 0, there is no limit.
+             */
+            size_t maxQueuedTasks { 0 };
+
+            /**
+             * What to do with a task started while there are maxQueuedTasks waiting to run.
+             */
+            OverflowPolicy overflowPolicy { OverflowPolicy::Block };
+        };
+
+        /**
+         * Options for a simulated task runner.
+         */
+        struct SimulationOptions {
+            /**
+             * Seed of the order ready tasks are run in.
+             */
+            uint64_t seed { 0 };
+        };
+
+        /**
+         * Task timings aggregated over all tasks that have stopped.
+         *
+         * <p>Latencies are in nanoseconds.
+         */
+        struct Metrics {
+            /**
+             * Time from being started on the runner to the action being run.
+             */
+            Histogram::Snapshot queueLatency;
+
+            /**
+             * Time from the action being run to it calling started(), for tasks that did.
+             */
+            Histogram::Snapshot startLatency;
+
+            /**
+             * Time from the action being run to the task being done.
+             */
+            Histogram::Snapshot runTime;
+
+            /**
+             * Time from the task being canceled to it being done, for tasks that were canceled.
+             */
+            Histogram::Snapshot cancelLatency;
+        };
+
+        /**
+         * A running task the watchdog found without a heartbeat for longer than its threshold.
+         */
+        struct StuckTask {
+            /**
+             * Id of the task.
+             */
+            uint64_t taskId { 0 };
+
+            /**
+             * State of the task when it was found.
+             */
+            Task::State state { Task::State::Created };
+
+            /**
+             * Time since its last heartbeat.
+             */
+            std::chrono::nanoseconds silence { 0 };
+        };
+
     private:
-        static inline bool taskComparator(std::shared_ptr<Task> const& lhs, std::shared_ptr<Task> const& rhs) noexcept {
-            return lhs->taskId < rhs->taskId;
+        struct MetricsRecorder {
+            Histogram queueLatency;
+            Histogram startLatency;
+            Histogram runTime;
+            Histogram cancelLatency;
+        };
+
+        // Queue whose chunks are recycled, so queuing doesn't allocate once warmed up.
+        template<typename T>
+        using Queue = std::deque<T, PoolAllocator<T>>;
+
+        struct Worker {
+            TaskRunner* const runner;
+            size_t const index;
+            Queue<std::shared_ptr<Task>> tasks;
+            std::mutex tasksLock;
+            std::thread thread;
+            // Elastic pools keep a slot for each possible worker, live or not.
+            std::atomic<bool> isLive { false };
+            // When the task it's running began, or 0 if idle. Only kept in elastic pools.
+            std::atomic<std::chrono::steady_clock::rep> busySince { 0 };
+            // NUMA node and CPUs it's placed on, if placed.
+            size_t node { 0 };
+            std::vector<unsigned> cpus;
+
+            Worker(TaskRunner* const runner, size_t const index) noexcept : runner(runner), index(index) {}
+        };
+
+        template<typename F, typename R>
+        class CallableTask : public Task, public FutureState<R> {
+        private:
+            F fn;
+
+        public:
+            explicit CallableTask(F&& fn) noexcept : fn(std::move(fn)) {}
+
+        protected:
+            void action() noexcept override {
+                started();
+                // Canceled before running, like by cancelAll.
+                if (shouldCancel()) {
+                    this->completeCanceled();
+                    return;
+                }
+                if constexpr (std::is_void_v<R>) {
+                    fn();
+                    this->complete();
+                } else {
+                    this->complete(fn());
+                }
+            }
+
+            void abandon() noexcept override {
+                this->completeCanceled();
+                Task::abandon();
+            }
+        };
+
+        // The task, its future and their control block share a single block from the pool.
+        template<typename F, typename Fn = std::decay_t<F>, typename R = std::invoke_result_t<Fn&>>
+        [[nodiscard]]
+        static std::shared_ptr<CallableTask<Fn, R>> makeCallableTask(F&& fn) noexcept {
+            return std::allocate_shared<CallableTask<Fn, R>>(PoolAllocator<CallableTask<Fn, R>> {}, Fn { std::forward<F>(fn) });
         }
 
+        // Live tasks, sharded by task id. Tasks are linked in place and own themselves while
+        // registered, so adding and removing is O(1) without allocating.
+        class TaskRegistry {
+        private:
+            static constexpr size_t shardCount { 32 };
+
+            struct alignas(64) Shard {
+                std::mutex lock;
+                Task* head { nullptr };
+            };
+
+            std::array<Shard, shardCount> shards;
+            std::atomic<size_t> count { 0 };
+
+        public:
+            bool add(std::shared_ptr<Task> const& task) noexcept {
+                if (task->registered.exchange(true)) {
+                    return false;
+                }
+                ++count;
+                Shard& shard { shards[task->taskId % shardCount] };
+                std::lock_guard<std::mutex> lock { shard.lock };
+                task->registeredSelf = task;
+                task->registryPrevious = nullptr;
+                task->registryNext = shard.head;
+                if (shard.head != nullptr) {
+                    shard.head->registryPrevious = task.get();
+                }
+                shard.head = task.get();
+                return true;
+            }
+
+            void remove(Task* const task) noexcept {
+                std::shared_ptr<Task> self;
+                Shard& shard { shards[task->taskId % shardCount] };
+                std::unique_lock<std::mutex> lock { shard.lock };
+                if (task->registryPrevious != nullptr) {
+                    task->registryPrevious->registryNext = task->registryNext;
+                } else {
+                    shard.head = task->registryNext;
+                }
+                if (task->registryNext != nullptr) {
+                    task->registryNext->registryPrevious = task->registryPrevious;
+                }
+                task->registryPrevious = nullptr;
+                task->registryNext = nullptr;
+                self = std::move(task->registeredSelf);
+                lock.unlock();
+                task->registered = false;
+                // The task may be released here, outside the lock.
+                self.reset();
+                if (--count == 0) {
+                    count.notify_all();
+                }
+            }
+
+            template<typename P>
+            [[nodiscard]]
+            std::vector<std::shared_ptr<Task>> collect(P const& predicate) noexcept {
+                std::vector<std::shared_ptr<Task>> found;
+                for (auto& shard: shards) {
+                    std::lock_guard<std::mutex> lock { shard.lock };
+                    for (Task* task { shard.head }; task != nullptr; task = task->registryNext) {
+                        if (predicate(*task)) {
+                            found.push_back(task->registeredSelf);
+                        }
+                    }
+                }
+                return found;
+            }
+
+            // Canceled outside the shard locks, since stop callbacks may start or finish tasks.
+            void cancelAll() noexcept {
+                std::vector<std::shared_ptr<Task>> const found { collect([](Task&) { return true; }) };
+                for (auto const& task: found) {
+                    task->cancel();
+                }
+            }
+
+            [[nodiscard]]
+            bool isEmpty() const noexcept {
+                return count == 0;
+            }
+
+            void awaitEmpty() const noexcept {
+                size_t current { count };
+                while (current > 0) {
+                    count.wait(current);
+                    current = count;
+                }
+            }
+        };
+
+        struct PendingTask {
+            std::shared_ptr<Task> task;
+            std::chrono::steady_clock::time_point enqueuedAt;
+        };
+
+        // Where a task is queued, decided once per enqueue.
+        struct Placement {
+            Task::Priority priority;
+            size_t node;
+            bool isLocal;
+        };
+
+        // Tasks with an affinity for a node, and the node's idle workers. Guarded by pendingTasksLock.
+        struct Node {
+            Queue<PendingTask> tasks;
+            size_t idleWorkerCount { 0 };
+            std::condition_variable signal;
+        };
+
+        // Ready tasks and pending timers of a simulated runner. Guarded by pendingTasksLock.
+        struct Simulation {
+            std::mt19937_64 engine;
+            std::atomic<std::chrono::steady_clock::rep> now { 0 };
+            std::vector<std::shared_ptr<Task>> readyTasks;
+            // Timers due at the same time fire in the order they were scheduled.
+            std::multimap<std::chrono::steady_clock::time_point, std::shared_ptr<ScheduledTaskRunner::Timer>> timers;
+
+            explicit Simulation(uint64_t const seed) noexcept : engine(seed) {}
+        };
+
+        enum class Admission : int {
+            Admitted,
+            Rejected,
+            RunByCaller
+        };
+
+        static constexpr size_t priorityCount { static_cast<size_t>(Task::Priority::High) + 1 };
+
+        static inline thread_local Worker* currentWorker { nullptr };
+
     private:
         std::atomic<bool> _isActive { true };
-        std::set<std::shared_ptr<Task>, decltype(&taskComparator)> tasks { taskComparator };
-        std::mutex tasksLock;
-        std::condition_variable isEmptySignal;
-        std::thread threadController;
-        std::mutex threadControllerLock;
-        bool threadControllerShouldExit { false };
-        std::vector<std::shared_ptr<Task>> finishingTasks;
-        std::condition_variable threadControllerWakeUpSignal;
+        TaskRegistry tasks;
+        std::mutex threadsLock;
+        std::vector<std::thread> finishedThreads;
+        std::vector<std::unique_ptr<Worker>> workers;
+        bool workStealing { false };
+        std::chrono::steady_clock::duration priorityAging { 0 };
+        std::array<Queue<PendingTask>, priorityCount> pendingTasks;
+        std::atomic<size_t> pendingHighPriorityCount { 0 };
+        std::atomic<size_t> pendingTaskCount { 0 };
+        std::vector<std::unique_ptr<Node>> nodes;
+        size_t nodeTaskCount { 0 };
+        std::mutex pendingTasksLock;
+        bool workersShouldExit { false };
+        std::condition_variable pendingTasksSignal;
+        std::atomic<size_t> queuedTaskCount { 0 };
+        std::atomic<size_t> idleWorkerCount { 0 };
+        std::atomic<size_t> liveWorkerCount { 0 };
+        size_t minWorkerCount { 0 };
+        std::chrono::steady_clock::duration idleTimeout { 0 };
+        std::mutex poolLock;
+        bool poolShouldExit { false };
+        // Admission bound, 0 if unbounded. Admitted tasks hold a slot until they run, or until
+        // their thread is done without a pool.
+        size_t admissionCapacity { 0 };
+        OverflowPolicy overflowPolicy { OverflowPolicy::Block };
+        std::atomic<size_t> admittedTaskCount { 0 };
+        std::atomic<size_t> blockedStarterCount { 0 };
+        std::atomic<uint64_t> admittedStat { 0 };
+        std::atomic<uint64_t> blockedStat { 0 };
+        std::atomic<uint64_t> rejectedStat { 0 };
+        std::atomic<uint64_t> ranByCallerStat { 0 };
+        std::atomic<uint64_t> droppedStat { 0 };
+        std::unique_ptr<MetricsRecorder> metrics;
+        std::unique_ptr<TraceRecorder> tracer;
+        std::unique_ptr<Simulation> simulation;
+        // Tasks running without a heartbeat for longer are stuck, 0 if there is no watchdog.
+        std::chrono::steady_clock::duration watchdogThreshold { 0 };
+        std::unique_ptr<ScheduledTaskRunner> timers;
+        std::mutex timersLock;
+        bool timersShouldExit { false };
 
     public:
         /**
-         * Creates a task runner.
-         */
-        TaskRunner() noexcept {
-            threadController = std::thread {
-                // Waits for threads to join and removes them from the set.
-                [this]{
-                    std::unique_lock<std::mutex> lock { threadControllerLock };
-                    while (true) {
-                        threadControllerWakeUpSignal.wait(lock, [this]{ return threadControllerShouldExit || !finishingTasks.empty(); });
-                        if (threadControllerShouldExit) {
-                            break;
-                        }
-                        for (auto& task: finishingTasks) {
-                            task->thread.join();
-                            removeTask(task);
-                        }
-                        finishingTasks.clear();
-                    }
-                }
-            };
+         * Creates a task runner that runs each task in its own thread.
+         *
+         * <p>Finished threads are joined in batches, when the next task is started or at shutdown.
+         */
+        TaskRunner() noexcept = default;
+
+        /**
+         * Creates a task runner that runs each task in its own thread, up to a limit.
+         *
+         * @param options Thread options.
+         */
+        explicit TaskRunner(ThreadOptions const& options) noexcept :
+            admissionCapacity(options.maxThreads), overflowPolicy(options.overflowPolicy) {}
+
+        /**
+         * Creates a task runner with a fixed pool of worker threads.
+         *
+         * <p>Tasks are queued and run on the first available worker. Because start blocks until
+         * the task has started, do not call start from within a task's action when all workers
+         * may be busy, as it will wait until one of them is free. Use startAsync instead.
+         *
+         * @param workerCount Number of worker threads. If 0, the hardware concurrency is used.
+         */
+        explicit TaskRunner(size_t const workerCount) noexcept : TaskRunner(Options { .workerCount = workerCount }) {}
+
+        /**
+         * Creates a task runner with a pool of worker threads configured by the given options.
+         *
+         * <p>With work stealing, a task started from within a running task's action on this
+         * runner goes to the local queue of the worker running it. If no other worker has
+         * stolen it by the time start waits for it, the starting worker runs it itself.
+         *
+         * @param options Pool options.
+         */
+        explicit TaskRunner(Options const& options) noexcept :
+            workStealing(options.workStealing), priorityAging(options.priorityAging),
+            admissionCapacity(options.maxQueuedTasks), overflowPolicy(options.overflowPolicy) {
+            size_t const count { options.workerCount > 0 ? options.workerCount : std::max(std::thread::hardware_concurrency(), 1u) };
+            size_t const maxCount { std::max(count, options.maxWorkerCount) };
+            workers.reserve(maxCount);
+            for (size_t i = 0; i < maxCount; ++i) {
+                workers.push_back(std::make_unique<Worker>(this, i));
+            }
+            minWorkerCount = count;
+            if (options.workerAffinity != WorkerAffinity::None) {
+                placeWorkers(options.workerAffinity, options.topology != nullptr ? *options.topology : CpuTopology::detect());
+            }
+            if (isElastic()) {
+                idleTimeout = std::max(options.idleTimeout, std::chrono::milliseconds(1));
+            }
+            std::lock_guard<std::mutex> lock { poolLock };
+            for (size_t i = 0; i < count; ++i) {
+                startWorker(*workers[i]);
+            }
+            if (isElastic() && (options.blockedWorkerTimeout.count() > 0)) {
+                std::chrono::steady_clock::duration const timeout { options.blockedWorkerTimeout };
+                timers = std::make_unique<ScheduledTaskRunner>();
+                timers->scheduleWithFixedDelay(timeout, timeout, [this, timeout]{ compensateBlockedWorkers(timeout); });
+            }
         }
 
+        /**
+         * Creates a simulated task runner.
+         *
+         * <p>Started tasks are queued, and only run while the runner is driven by runUntilIdle,
+         * advance, awaitAll, shutdown, or by start waiting for a task to start. Each step runs
+         * a ready task picked at random, and once none is ready, the clock jumps to the next
+         * timer, like a coroutine task's coSleep. Task actions run to completion on the driving
+         * thread, so they must not block on other tasks of the runner. Tasks that can never
+         * run again by the time it shuts down are canceled and released.
+         *
+         * <p>Drive it from a single thread.
+         *
+         * @param options Simulation options.
+         */
+        explicit TaskRunner(SimulationOptions const& options) noexcept :
+            simulation(std::make_unique<Simulation>(options.seed)) {}
+
         /**
          * Destroys the task runner.
          *
@@ -79,83 +619,1270 @@ namespace gb {
         }
 
         /**
-         * Shuts down the runner.
+         * Returns true if the runner executes tasks on a pool of worker threads.
          *
-         * <p>Cancels all tasks and awaits on all tasks to stop.
+         * @return True if the runner executes tasks on a pool of worker threads.
          */
-        void shutdown() noexcept {
-            std::unique_lock<std::mutex> lock { tasksLock };
-            if (!_isActive.compare_exchange_strong(_true, false)) {
-                return;
+        [[nodiscard]]
+        bool isPooled() const noexcept {
+            return !workers.empty();
+        }
+
+        /**
+         * Returns true if the runner is simulated.
+         *
+         * @return True if the runner is simulated.
+         */
+        [[nodiscard]]
+        bool isSimulated() const noexcept {
+            return simulation != nullptr;
+        }
+
+        /**
+         * Returns the current time of the runner's clock.
+         *
+         * <p>A simulated runner's clock starts at the clock's epoch and only moves when the
+         * runner is driven.
+         *
+         * @return The current time, virtual if the runner is simulated.
+         */
+        [[nodiscard]]
+        std::chrono::steady_clock::time_point now() const noexcept {
+            if (simulation) {
+                return std::chrono::steady_clock::time_point { std::chrono::steady_clock::duration { simulation->now.load(std::memory_order_relaxed) } };
             }
-            for (auto const& task: tasks) {
-                task->cancel();
+            return std::chrono::steady_clock::now();
+        }
+
+        /**
+         * Runs ready tasks, and timers due now, until there are none, without moving a
+         * simulated runner's clock.
+         *
+         * <p>Does nothing if the runner is not simulated.
+         */
+        void runUntilIdle() noexcept {
+            if (simulation) {
+                while (simulateStep(now())) {}
             }
-            isEmptySignal.wait(lock, [this]{ return tasks.empty(); });
-            lock.unlock();
-            std::unique_lock<std::mutex> controllerLock { threadControllerLock };
-            threadControllerShouldExit = true;
-            threadControllerWakeUpSignal.notify_one();
-            controllerLock.unlock();
-            threadController.join();
         }
 
         /**
-         * Starts a task.
+         * Moves a simulated runner's clock forward, running ready tasks and firing timers in
+         * order of their due time along the way.
          *
-         * <p>This method will block until the task signals it has started.
+         * <p>Does nothing if the runner is not simulated.
          *
-         * @param task Task to start.
-         * @return True if the task was started, false if the runner is not active.
+         * @param duration Time to move the clock forward by.
          */
-        bool start(std::shared_ptr<Task> const& task) noexcept {
-            std::lock_guard<std::mutex> lock { tasksLock };
-            if (!isActive()) {
-                return false;
+        void advance(std::chrono::steady_clock::duration const duration) noexcept {
+            if (!simulation) {
+                return;
             }
-            auto const& [ _, success] = tasks.insert(task);
-            if (!success) {
-                return false;
+            std::chrono::steady_clock::time_point const until { now() + duration };
+            while (simulateStep(until)) {}
+            simulation->now.store(until.time_since_epoch().count(), std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the number of worker threads in the pool.
+         *
+         * <p>In an elastic pool, it's the number of workers right now.
+         *
+         * @return The number of worker threads in the pool, or 0 if the runner is not pooled.
+         */
+        [[nodiscard]]
+        size_t getWorkerCount() const noexcept {
+            return liveWorkerCount;
+        }
+
+        /**
+         * Returns counts of what happened to tasks started on the runner, if bounded.
+         *
+         * @return Admission counts, all 0 if the runner is not bounded.
+         */
+        [[nodiscard]]
+        AdmissionStats getAdmissionStats() const noexcept {
+            return {
+                admittedStat.load(std::memory_order_relaxed),
+                blockedStat.load(std::memory_order_relaxed),
+                rejectedStat.load(std::memory_order_relaxed),
+                ranByCallerStat.load(std::memory_order_relaxed),
+                droppedStat.load(std::memory_order_relaxed)
+            };
+        }
+
+        /**
+         * Returns the number of NUMA nodes workers are placed on.
+         *
+         * <p>Nodes keep the ids of the topology, and those without CPUs get no workers. Their
+         * tasks are run by workers of other nodes.
+         *
+         * @return The number of NUMA nodes of the topology workers are placed on, or 0 if they
+         *     are not placed by node.
+         */
+        [[nodiscard]]
+        size_t getNodeCount() const noexcept {
+            return nodes.size();
+        }
+
+        /**
+         * Returns the NUMA node of the worker running the calling thread.
+         *
+         * <p>Tasks can use it to allocate memory local to the node they run on.
+         *
+         * @return The NUMA node of the calling worker, or Task::anyNode if not called from a
+         *     worker of this runner placed by node.
+         */
+        [[nodiscard]]
+        size_t getCurrentNode() const noexcept {
+            Worker const* const worker { getCurrentWorker() };
+            return (worker != nullptr) && !nodes.empty() ? worker->node : Task::anyNode;
+        }
+
+        /**
+         * Starts recording task timings, per task and aggregated.
+         *
+         * <p>Call before starting tasks. Until then, timings cost nothing.
+         */
+        void enableMetrics() noexcept {
+            if (!metrics) {
+                metrics = std::make_unique<MetricsRecorder>();
             }
-            task->setTaskRunner(this);
-            task->thread = std::thread {
-                [this, task]{
-                    task->action();
-                    task->finished();
-                    std::lock_guard<std::mutex> lock { threadControllerLock };
-                    finishingTasks.push_back(task);
-                    threadControllerWakeUpSignal.notify_one();
-                }
+        }
+
+        /**
+         * Returns the task timings aggregated over all tasks that have stopped.
+         *
+         * @return The aggregated task timings, empty if metrics are not enabled.
+         */
+        [[nodiscard]]
+        Metrics getMetrics() const noexcept {
+            if (!metrics) {
+                return {};
+            }
+            return {
+                metrics->queueLatency.snapshot(),
+                metrics->startLatency.snapshot(),
+                metrics->runTime.snapshot(),
+                metrics->cancelLatency.snapshot()
             };
-            task->awaitStart();
-            return true;
         }
 
         /**
-         * Cancels all tasks.
+         * Starts recording when each task runs, and on which thread.
+         *
+         * <p>Call before starting tasks. Until then, tracing costs nothing. Only the most recent
+         * events of the most recent threads are kept, so it can stay on, see TraceRecorder.
          */
-        void cancelAll() noexcept {
-            std::lock_guard<std::mutex> lock { tasksLock };
-            for (auto const& task: tasks) {
-                task->cancel();
+        void enableTracing() noexcept {
+            if (!tracer) {
+                tracer = std::make_unique<TraceRecorder>();
             }
         }
 
         /**
-         * Awaits for all tasks to finish.
+         * Writes what was traced so far as Chrome trace event JSON.
+         *
+         * <p>Each run of a task is a slice on the thread it ran on, with the task id in its args.
+         * Open it in chrome://tracing or ui.perfetto.dev.
+         *
+         * @param out Stream to write to. Nothing is written if tracing is not enabled.
          */
-        void awaitAll() noexcept {
-            std::unique_lock<std::mutex> lock { tasksLock };
-            isEmptySignal.wait(lock, [this]{ return tasks.empty(); });
+        void writeTrace(std::ostream& out) noexcept {
+            if (tracer) {
+                tracer->write(out);
+            }
         }
 
-    private:
-        void removeTask(std::shared_ptr<Task> const& task) noexcept {
-            std::lock_guard<std::mutex> lock { tasksLock };
-            tasks.erase(task);
-            if (tasks.empty()) {
-                isEmptySignal.notify_one();
+        /**
+         * Starts a watchdog that reports tasks running without a heartbeat for longer than the
+         * threshold.
+         *
+         * <p>A task beginning to run counts as a heartbeat, and so does each call to
+         * Task::heartbeat. Each stall is reported once, from the watchdog's thread, within a
+         * quarter of the threshold of happening. The watchdog keeps running while shutdown
+         * awaits for tasks to stop, so tasks keeping it from returning get reported.
+         *
+         * <p>Call before starting tasks, once. Simulated runners have no watchdog.
+         *
+         * @param threshold Time without a heartbeat after which a task is stuck.
+         * @param onStuckTask Called for each stuck task. Keep it short, it delays the runner's timers.
+         */
+        void enableWatchdog(std::chrono::steady_clock::duration const threshold,
+            std::function<void(StuckTask const&)> onStuckTask) noexcept {
+            if (simulation || (threshold.count() <= 0) || (watchdogThreshold.count() > 0)) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock { timersLock };
+            if (timersShouldExit) {
+                return;
+            }
+            watchdogThreshold = threshold;
+            if (!timers) {
+                timers = std::make_unique<ScheduledTaskRunner>();
+            }
+            std::chrono::steady_clock::duration const period {
+                std::max<std::chrono::steady_clock::duration>(threshold / 4, std::chrono::milliseconds(1))
+            };
+            timers->scheduleWithFixedDelay(period, period, [this, onStuckTask = std::move(onStuckTask)]{
+                reportStuckTasks(onStuckTask);
+            });
+        }
+
+        /**
+         * Shuts down the runner.
+         *
+         * <p>Cancels all tasks and awaits on all tasks to stop.
+         */
+        void shutdown() noexcept {
+            // Don't compare against the shared _true, a failed exchange would overwrite it.
+            bool wasActive { true };
+            if (!_isActive.compare_exchange_strong(wasActive, false)) {
+                return;
+            }
+            tasks.cancelAll();
+            if (simulation) {
+                while (!tasks.isEmpty() && simulateStep()) {}
+                // Tasks that can never run again are stopped and released, instead of hanging.
+                std::vector<std::shared_ptr<Task>> const leftovers { tasks.collect([](Task&) { return true; }) };
+                for (auto const& task: leftovers) {
+                    tasks.remove(task.get());
+                    task->abandon();
+                }
+                std::unique_lock<std::mutex> lock { pendingTasksLock };
+                std::vector<std::shared_ptr<Task>> const readyTasks { std::move(simulation->readyTasks) };
+                auto const pendingTimers { std::move(simulation->timers) };
+                lock.unlock();
+                return;
+            }
+            tasks.awaitEmpty();
+            std::unique_lock<std::mutex> timerLock { timersLock };
+            timersShouldExit = true;
+            std::unique_ptr<ScheduledTaskRunner> const timerRunner { std::move(timers) };
+            timerLock.unlock();
+            if (isPooled()) {
+                std::lock_guard<std::mutex> lock { poolLock };
+                poolShouldExit = true;
+                std::unique_lock<std::mutex> pendingLock { pendingTasksLock };
+                workersShouldExit = true;
+                pendingTasksSignal.notify_all();
+                for (auto const& node: nodes) {
+                    node->signal.notify_all();
+                }
+                pendingLock.unlock();
+                // Including retired workers not yet joined.
+                for (auto const& worker: workers) {
+                    if (worker->thread.joinable()) {
+                        worker->thread.join();
+                    }
+                }
+                return;
+            }
+            // All task threads have handed themselves over by the time their task is removed.
+            std::unique_lock<std::mutex> threadLock { threadsLock };
+            std::vector<std::thread> threadsToJoin { std::move(finishedThreads) };
+            threadLock.unlock();
+            for (auto& thread: threadsToJoin) {
+                thread.join();
+            }
+        }
+
+        /**
+         * Starts a task.
+         *
+         * <p>This method will block until the task signals it has started.
+         *
+         * <p>Called from within a task on a work stealing pool, it may run the task's whole action
+         * on the calling worker before returning. A task that waits for the starting task after
+         * signaling it has started would deadlock. Start it with startAsync and await it with
+         * Task::awaitStart instead.
+         *
+         * <p>If the runner is bounded and full, its overflow policy applies.
+         *
+         * @param task Task to start.
+         * @return True if the task was started, false if the runner is not active or rejected it.
+         */
+        bool start(std::shared_ptr<Task> const& task) noexcept {
+            return startTask(task, true);
+        }
+
+        /**
+         * Starts a task without waiting for it to signal it has started.
+         *
+         * <p>The task is queued, or its thread created, and this method returns right away. Call
+         * Task::awaitStart on the task when readiness is needed.
+         *
+         * <p>If the runner is bounded and full, its overflow policy applies, and this method may
+         * block or run the task.
+         *
+         * @param task Task to start.
+         * @return True if the task was accepted, false if the runner is not active or rejected it.
+         */
+        bool startAsync(std::shared_ptr<Task> const& task) noexcept {
+            return startTask(task, false);
+        }
+
+        /**
+         * Submits a function to run as a task, and returns a future for its result.
+         *
+         * <p>Like startAsync, this method returns right away, unless the runner is bounded and
+         * full. The task and the future share a single block, recycled from a pool, and
+         * continuations added to the future run on the thread that ran the function. If the
+         * task is canceled before it runs, the function isn't called and the future is canceled.
+         *
+         * @tparam F Function type.
+         * @param fn Function to run.
+         * @param priority Priority of the task.
+         * @return A future for the result of the function, invalid if the runner is not active or
+         *     rejected it.
+         */
+        template<typename F>
+        auto submit(F&& fn, Task::Priority const priority = Task::Priority::Normal) noexcept {
+            using Fn = std::decay_t<F>;
+            using R = std::invoke_result_t<Fn&>;
+            std::shared_ptr<CallableTask<Fn, R>> const task { makeCallableTask(std::forward<F>(fn)) };
+            task->setPriority(priority);
+            if (!startTask(task, false)) {
+                return Future<R> {};
+            }
+            return Future<R> { task };
+        }
+
+        /**
+         * Starts a coroutine task.
+         *
+         * <p>This method does not block. On a pooled runner the coroutine is resumed on the
+         * workers, otherwise it gets its own thread. A coroutine task can only be started once.
+         *
+         * @tparam T Coroutine result type.
+         * @param coTask Coroutine task to start.
+         * @return True if the coroutine task was started, false if it was already started or the runner is not active.
+         */
+        template<typename T>
+        bool start(CoTask<T> const& coTask) noexcept;
+
+        /**
+         * Starts a batch of tasks.
+         *
+         * <p>All tasks are launched together before waiting for any of them, then this method
+         * blocks until all the started ones signal they have started. Tasks that are already
+         * running are skipped.
+         *
+         * <p>If the runner is bounded, each task is admitted as it's launched, and its overflow
+         * policy applies to it like with startAsync.
+         *
+         * @param batch Tasks to start.
+         * @return The number of tasks started, which is 0 if the runner is not active.
+         */
+        size_t startAll(std::span<std::shared_ptr<Task> const> const batch) noexcept {
+            std::vector<std::shared_ptr<Task>> accepted;
+            accepted.reserve(batch.size());
+            if (admissionCapacity > 0) {
+                // Admitted tasks must be queued before blocking on room for the next ones.
+                for (auto const& task: batch) {
+                    if (startTask(task, false)) {
+                        accepted.push_back(task);
+                    }
+                }
+            } else {
+                for (auto const& task: batch) {
+                    if (registerTask(task)) {
+                        accepted.push_back(task);
+                    }
+                }
+                if (queuesTasks()) {
+                    enqueueTasks(accepted);
+                } else {
+                    for (auto const& task: accepted) {
+                        startThread(task);
+                    }
+                }
+            }
+            // Newest first, so a worker can run the ones still on its own queue.
+            for (auto it = accepted.rbegin(); it != accepted.rend(); ++it) {
+                awaitTaskStart(*it);
+            }
+            return accepted.size();
+        }
+
+        /**
+         * Cancels all tasks.
+         */
+        void cancelAll() noexcept {
+            tasks.cancelAll();
+        }
+
+        /**
+         * Awaits for all tasks to finish.
+         *
+         * <p>A simulated runner is driven until all tasks finish, moving its clock as far as
+         * needed, or until none of them can run again.
+         */
+        void awaitAll() noexcept {
+            if (simulation) {
+                while (!tasks.isEmpty() && simulateStep()) {}
+                return;
+            }
+            tasks.awaitEmpty();
+        }
+
+    private:
+        bool registerTask(std::shared_ptr<Task> const& task) noexcept {
+            if (!isActive()) {
+                return false;
+            }
+            if (!tasks.add(task)) {
+                return false;
+            }
+            if (!isActive()) {
+                // Shutdown started and may have missed this task when canceling.
+                tasks.remove(task.get());
+                return false;
+            }
+            task->setTaskRunner(this);
+            if (metrics) {
+                task->recordsMetrics.store(true, std::memory_order_relaxed);
+                task->queuedAt = std::chrono::steady_clock::now();
+            }
+            if (tracer) {
+                task->traceId = tracer->newId();
+            }
+            return true;
+        }
+
+        bool startTask(std::shared_ptr<Task> const& task, bool const shouldAwaitStart, bool const skipsAdmission = false) noexcept {
+            return startTask(task, shouldAwaitStart, skipsAdmission, [](Task&) {});
+        }
+
+        // Prepares the task once it's registered, before it can run. A task that is already
+        // registered, and so may be running, is never prepared.
+        template<typename P>
+        bool startTask(std::shared_ptr<Task> const& task, bool const shouldAwaitStart, bool const skipsAdmission,
+            P const& prepare) noexcept {
+            bool isAdmitted { false };
+            if ((admissionCapacity > 0) && !skipsAdmission && isActive()) {
+                switch (admit()) {
+                    case Admission::Rejected:
+                        return false;
+                    case Admission::RunByCaller:
+                        if (!registerTask(task)) {
+                            return false;
+                        }
+                        ranByCallerStat.fetch_add(1, std::memory_order_relaxed);
+                        prepare(*task);
+                        if (!queuesTasks() && task->canSuspend()) {
+                            // It would never be resumed once suspended on the caller.
+                            startThread(task);
+                        } else {
+                            runTask(task);
+                        }
+                        return true;
+                    case Admission::Admitted:
+                        isAdmitted = true;
+                        break;
+                }
+            }
+            if (!registerTask(task)) {
+                if (isAdmitted) {
+                    releaseAdmissionSlot();
+                }
+                return false;
+            }
+            if (isAdmitted) {
+                admittedStat.fetch_add(1, std::memory_order_relaxed);
+            }
+            prepare(*task);
+            task->holdsAdmission = isAdmitted;
+            if (queuesTasks()) {
+                enqueueTask(task);
+            } else {
+                startThread(task);
+            }
+            if (shouldAwaitStart) {
+                awaitTaskStart(task);
+            }
+            return true;
+        }
+
+        // True if started tasks are queued, instead of getting their own thread.
+        [[nodiscard]]
+        bool queuesTasks() const noexcept {
+            return isPooled() || simulation;
+        }
+
+        void awaitTaskStart(std::shared_ptr<Task> const& task) noexcept {
+            if (simulation) {
+                while ((task->getState() == Task::State::Created) && task->registered && simulateStep()) {}
+                return;
+            }
+            if (isPooled() && runLocalTask(task)) {
+                return;
+            }
+            task->awaitStart();
+        }
+
+        void startThread(std::shared_ptr<Task> const& task) noexcept {
+            // The thread can't hand itself over until it's assigned, so assign under the lock.
+            std::unique_lock<std::mutex> lock { threadsLock };
+            std::vector<std::thread> threadsToJoin { std::move(finishedThreads) };
+            finishedThreads.clear();
+            task->thread = std::thread {
+                [this, task]{
+                    Task::currentTask = task.get();
+                    markRun(*task);
+                    beginHeartbeat(*task);
+                    traceBegin(*task);
+                    task->action();
+                    traceEnd(*task);
+                    endHeartbeat(*task);
+                    recordMetrics(*task);
+                    task->finished();
+                    releaseAdmission(*task);
+                    // Hand over this thread to be joined, no need to wake anyone up.
+                    std::unique_lock<std::mutex> threadLock { threadsLock };
+                    finishedThreads.push_back(std::move(task->thread));
+                    threadLock.unlock();
+                    tasks.remove(task.get());
+                }
+            };
+            lock.unlock();
+            // These threads are done or about to be.
+            for (auto& thread: threadsToJoin) {
+                thread.join();
+            }
+        }
+
+        [[nodiscard]]
+        Worker* getCurrentWorker() const noexcept {
+            Worker* const worker { currentWorker };
+            return (worker != nullptr) && (worker->runner == this) ? worker : nullptr;
+        }
+
+        void enqueueTask(std::shared_ptr<Task> const& task) noexcept {
+            enqueueTasks({ &task, 1 });
+        }
+
+        void enqueueTasks(std::span<std::shared_ptr<Task> const> const batch) noexcept {
+            if (simulation) {
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                for (auto const& task: batch) {
+                    ++queuedTaskCount;
+                    simulation->readyTasks.push_back(task);
+                }
+                return;
+            }
+            Worker* const worker { workStealing ? getCurrentWorker() : nullptr };
+            // Placed once, so a concurrent change of priority or node can't queue a task in
+            // both passes, or in neither.
+            Placement single;
+            std::vector<Placement> placements;
+            std::span<Placement> placed { &single, 1 };
+            if (batch.size() > 1) {
+                placements.resize(batch.size());
+                placed = placements;
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                placed[i] = placeTask(*batch[i], worker);
+            }
+            size_t localCount { 0 };
+            if (worker != nullptr) {
+                std::lock_guard<std::mutex> lock { worker->tasksLock };
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    if (placed[i].isLocal) {
+                        ++queuedTaskCount;
+                        worker->tasks.push_back(batch[i]);
+                        ++localCount;
+                    }
+                }
+            }
+            if (localCount < batch.size()) {
+                std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                size_t pendingCount { 0 };
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    Placement const& placement { placed[i] };
+                    if (placement.isLocal) {
+                        continue;
+                    }
+                    ++queuedTaskCount;
+                    if (placement.node != Task::anyNode) {
+                        nodes[placement.node]->tasks.push_back({ batch[i], now });
+                        ++nodeTaskCount;
+                        notifyNodeWorkers(placement.node);
+                        continue;
+                    }
+                    if (placement.priority == Task::Priority::High) {
+                        ++pendingHighPriorityCount;
+                    }
+                    ++pendingTaskCount;
+                    pendingTasks[static_cast<size_t>(placement.priority)].push_back({ batch[i], now });
+                    ++pendingCount;
+                }
+                if (pendingCount > 0) {
+                    notifyIdleWorkers(pendingCount);
+                }
+            } else if (idleWorkerCount > 0) {
+                // Idle workers check the queued count after announcing themselves idle, so
+                // either they see these tasks or we see them.
+                std::lock_guard<std::mutex> pendingLock { pendingTasksLock };
+                notifyIdleWorkers(batch.size());
+            }
+            // Even idle workers would leave tasks queued.
+            if (isElastic() && (queuedTaskCount > liveWorkerCount)) {
+                addWorker();
+            }
+        }
+
+        // Must be called with pendingTasksLock held.
+        void notifyIdleWorkers(size_t const taskCount) noexcept {
+            if (nodes.empty()) {
+                if (taskCount == 1) {
+                    pendingTasksSignal.notify_one();
+                } else {
+                    pendingTasksSignal.notify_all();
+                }
+                return;
+            }
+            for (auto const& node: nodes) {
+                if (node->idleWorkerCount == 0) {
+                    continue;
+                }
+                if (taskCount == 1) {
+                    node->signal.notify_one();
+                    return;
+                }
+                node->signal.notify_all();
+            }
+        }
+
+        // Must be called with pendingTasksLock held.
+        void notifyNodeWorkers(size_t const node) noexcept {
+            if (nodes[node]->idleWorkerCount > 0) {
+                nodes[node]->signal.notify_one();
+            } else {
+                // Workers of other nodes may take it.
+                notifyIdleWorkers(1);
+            }
+        }
+
+        // Returns the node a task is queued for, or anyNode if it's not queued by node.
+        [[nodiscard]]
+        size_t getTaskNode(Task const& task) const noexcept {
+            if (nodes.empty()) {
+                return Task::anyNode;
+            }
+            size_t const node { task.getNodeAffinity() };
+            return node < nodes.size() ? node : Task::anyNode;
+        }
+
+        // Only normal priority tasks go to the local queue of the calling worker, which is not
+        // prioritized, and only if they can run on the worker's node.
+        [[nodiscard]]
+        Placement placeTask(Task const& task, Worker const* const worker) const noexcept {
+            Task::Priority const priority { task.getPriority() };
+            size_t const node { getTaskNode(task) };
+            bool const isLocal {
+                (worker != nullptr) && (priority == Task::Priority::Normal) && ((node == Task::anyNode) || (node == worker->node))
+            };
+            return { priority, node, isLocal };
+        }
+
+        // Must be called with pendingTasksLock held.
+        [[nodiscard]]
+        std::shared_ptr<Task> dequeueNodeTask(Node& node) noexcept {
+            if (node.tasks.empty()) {
+                return nullptr;
+            }
+            std::shared_ptr<Task> task { std::move(node.tasks.front().task) };
+            node.tasks.pop_front();
+            --queuedTaskCount;
+            --nodeTaskCount;
+            return task;
+        }
+
+        // Must be called with pendingTasksLock held.
+        [[nodiscard]]
+        bool hasTaskFor(Worker const& worker) const noexcept {
+            if (nodes.empty() || (queuedTaskCount > nodeTaskCount)) {
+                return queuedTaskCount > 0;
+            }
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                Node const& node { *nodes[i] };
+                if (!node.tasks.empty() && ((i == worker.node) || (node.idleWorkerCount == 0))) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Nodes keep the topology's ids, but workers are only placed on nodes with CPUs.
+        void placeWorkers(WorkerAffinity const affinity, CpuTopology const& topology) noexcept {
+            size_t const nodeCount { std::max(topology.getNodeCount(), size_t { 1 }) };
+            std::vector<size_t> usableNodes;
+            for (size_t i = 0; i < nodeCount; ++i) {
+                nodes.push_back(std::make_unique<Node>());
+                if ((i < topology.getNodeCount()) && !topology.getCpus(i).empty()) {
+                    usableNodes.push_back(i);
+                }
+            }
+            for (auto const& worker: workers) {
+                if (usableNodes.empty()) {
+                    worker->node = worker->index % nodeCount;
+                    continue;
+                }
+                worker->node = usableNodes[worker->index % usableNodes.size()];
+                std::vector<unsigned> const& cpus { topology.getCpus(worker->node) };
+                if (affinity == WorkerAffinity::Cpu) {
+                    worker->cpus = { cpus[(worker->index / usableNodes.size()) % cpus.size()] };
+                } else {
+                    worker->cpus = cpus;
+                }
+            }
+        }
+
+        bool runLocalTask(std::shared_ptr<Task> const& task) noexcept {
+            Worker* const worker { workStealing ? getCurrentWorker() : nullptr };
+            if (worker == nullptr) {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock { worker->tasksLock };
+            if (worker->tasks.empty() || (worker->tasks.back() != task)) {
+                // Stolen.
+                return false;
+            }
+            worker->tasks.pop_back();
+            --queuedTaskCount;
+            lock.unlock();
+            runTask(task);
+            return true;
+        }
+
+        // Priority of the front of the pending queue of priority index, raised by how long it
+        // has waited. Must be called with pendingTasksLock held.
+        [[nodiscard]]
+        size_t getEffectivePriority(size_t const index, std::chrono::steady_clock::time_point const now) const noexcept {
+            size_t effectivePriority { index };
+            if (priorityAging.count() > 0) {
+                effectivePriority += static_cast<size_t>((now - pendingTasks[index].front().enqueuedAt) / priorityAging);
+            }
+            return effectivePriority;
+        }
+
+        // Whether a pending task has aged past normal priority, so it goes ahead of local tasks.
+        // Must be called with pendingTasksLock held.
+        [[nodiscard]]
+        bool hasAgedPendingTask() const noexcept {
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            size_t const normal { static_cast<size_t>(Task::Priority::Normal) };
+            for (size_t i = 0; i <= normal; ++i) {
+                if (!pendingTasks[i].empty() && (getEffectivePriority(i, now) > normal)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Must be called with pendingTasksLock held.
+        [[nodiscard]]
+        std::shared_ptr<Task> dequeuePendingTask() noexcept {
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            Queue<PendingTask>* best { nullptr };
+            size_t bestPriority { 0 };
+            // Highest first, so it wins ties against aged lower priority tasks.
+            for (size_t i = priorityCount; i-- > 0;) {
+                Queue<PendingTask>& queue { pendingTasks[i] };
+                if (queue.empty()) {
+                    continue;
+                }
+                size_t const effectivePriority { getEffectivePriority(i, now) };
+                if ((best == nullptr) || (effectivePriority > bestPriority)) {
+                    best = &queue;
+                    bestPriority = effectivePriority;
+                }
+            }
+            if (best == nullptr) {
+                return nullptr;
+            }
+            std::shared_ptr<Task> task { std::move(best->front().task) };
+            best->pop_front();
+            --queuedTaskCount;
+            --pendingTaskCount;
+            if (best == &pendingTasks[static_cast<size_t>(Task::Priority::High)]) {
+                --pendingHighPriorityCount;
+            }
+            return task;
+        }
+
+        [[nodiscard]]
+        std::shared_ptr<Task> dequeueTask(Worker& worker) noexcept {
+            std::shared_ptr<Task> task;
+            if (workStealing && ((pendingHighPriorityCount > 0) || ((priorityAging.count() > 0) && (pendingTaskCount > 0)))) {
+                // High priority tasks, and those aged past normal, go ahead of local ones. Or a
+                // worker spawning children would starve them.
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                if ((pendingHighPriorityCount > 0) || hasAgedPendingTask()) {
+                    task = dequeuePendingTask();
+                    if (task) {
+                        return task;
+                    }
+                }
+            }
+            if (workStealing) {
+                // Newest local task first, while its data is still hot.
+                std::lock_guard<std::mutex> lock { worker.tasksLock };
+                if (!worker.tasks.empty()) {
+                    task = std::move(worker.tasks.back());
+                    worker.tasks.pop_back();
+                    --queuedTaskCount;
+                    return task;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                if (!nodes.empty()) {
+                    task = dequeueNodeTask(*nodes[worker.node]);
+                    if (task) {
+                        return task;
+                    }
+                }
+                task = dequeuePendingTask();
+                if (task) {
+                    return task;
+                }
+            }
+            if (workStealing) {
+                // Oldest task of another worker, which likely carries the most work.
+                size_t const count { workers.size() };
+                for (size_t i = 1; i < count; ++i) {
+                    Worker& victim { *workers[(worker.index + i) % count] };
+                    if (!victim.isLive) {
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock { victim.tasksLock };
+                    if (!victim.tasks.empty()) {
+                        task = std::move(victim.tasks.front());
+                        victim.tasks.pop_front();
+                        --queuedTaskCount;
+                        return task;
+                    }
+                }
+            }
+            if (!nodes.empty()) {
+                // Another node's task, but only if none of its workers is idle to run it.
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                for (size_t i = 1; i < nodes.size(); ++i) {
+                    Node& node { *nodes[(worker.node + i) % nodes.size()] };
+                    if (node.idleWorkerCount == 0) {
+                        task = dequeueNodeTask(node);
+                        if (task) {
+                            return task;
+                        }
+                    }
+                }
+            }
+            return task;
+        }
+
+        // Runs one queued task on the calling worker, so it can help while it waits. Returns
+        // false if not called from a worker of this runner, or there was nothing queued.
+        bool runQueuedTask() noexcept {
+            if (simulation) {
+                return simulateStep();
+            }
+            Worker* const worker { getCurrentWorker() };
+            if (worker == nullptr) {
+                return false;
+            }
+            std::shared_ptr<Task> const task { dequeueTask(*worker) };
+            if (!task) {
+                return false;
+            }
+            runTask(task);
+            return true;
+        }
+
+        [[nodiscard]]
+        bool isElastic() const noexcept {
+            return workers.size() > minWorkerCount;
+        }
+
+        // Must be called with poolLock held.
+        void startWorker(Worker& worker) noexcept {
+            worker.isLive = true;
+            ++liveWorkerCount;
+            worker.thread = std::thread { [this, &worker]{ workerLoop(worker); } };
+        }
+
+        void addWorker() noexcept {
+            std::lock_guard<std::mutex> lock { poolLock };
+            if (poolShouldExit || (liveWorkerCount >= workers.size())) {
+                return;
+            }
+            for (auto const& worker: workers) {
+                if (worker->isLive) {
+                    continue;
+                }
+                // A retired worker's thread is done, or about to be.
+                if (worker->thread.joinable()) {
+                    worker->thread.join();
+                }
+                startWorker(*worker);
+                return;
+            }
+        }
+
+        // Returns true if the worker should exit.
+        bool retireWorker(Worker& worker) noexcept {
+            std::lock_guard<std::mutex> lock { poolLock };
+            if ((liveWorkerCount <= minWorkerCount) || (queuedTaskCount > 0)) {
+                return false;
+            }
+            --liveWorkerCount;
+            worker.isLive = false;
+            return true;
+        }
+
+        // Called periodically in elastic pools.
+        void compensateBlockedWorkers(std::chrono::steady_clock::duration const timeout) noexcept {
+            if ((queuedTaskCount == 0) || (idleWorkerCount > 0)) {
+                return;
+            }
+            std::chrono::steady_clock::rep const blockedSince {
+                (std::chrono::steady_clock::now() - timeout).time_since_epoch().count()
+            };
+            for (auto const& worker: workers) {
+                std::chrono::steady_clock::rep const busySince { worker->busySince.load(std::memory_order_relaxed) };
+                if ((busySince != 0) && (busySince <= blockedSince)) {
+                    addWorker();
+                    return;
+                }
+            }
+        }
+
+        void workerLoop(Worker& worker) noexcept {
+            currentWorker = &worker;
+            if (!worker.cpus.empty()) {
+                CpuTopology::pinCurrentThread(worker.cpus);
+            }
+            bool const elastic { isElastic() };
+            Node* const node { nodes.empty() ? nullptr : nodes[worker.node].get() };
+            std::condition_variable& signal { node != nullptr ? node->signal : pendingTasksSignal };
+            while (true) {
+                std::shared_ptr<Task> const task { dequeueTask(worker) };
+                if (task) {
+                    if (elastic) {
+                        worker.busySince.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+                    }
+                    runTask(task);
+                    if (elastic) {
+                        worker.busySince.store(0, std::memory_order_relaxed);
+                    }
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock { pendingTasksLock };
+                ++idleWorkerCount;
+                if (node != nullptr) {
+                    ++node->idleWorkerCount;
+                }
+                auto const isReady { [this, &worker]{ return workersShouldExit || hasTaskFor(worker); } };
+                bool isWoken { true };
+                if (elastic) {
+                    isWoken = signal.wait_for(lock, idleTimeout, isReady);
+                } else {
+                    signal.wait(lock, isReady);
+                }
+                --idleWorkerCount;
+                if (node != nullptr) {
+                    --node->idleWorkerCount;
+                    if ((node->idleWorkerCount == 0) && (node->tasks.size() > 1)) {
+                        // Workers of other nodes may take the ones this one won't get to.
+                        notifyIdleWorkers(node->tasks.size() - 1);
+                    }
+                }
+                if (!isWoken) {
+                    lock.unlock();
+                    if (retireWorker(worker)) {
+                        break;
+                    }
+                    continue;
+                }
+                // Woken for a task another worker may have taken already, so only exit on
+                // shutdown, once all queued tasks have been run.
+                if (workersShouldExit && (queuedTaskCount == 0)) {
+                    break;
+                }
+            }
+            currentWorker = nullptr;
+        }
+
+        [[nodiscard]]
+        bool tryReserveAdmission() noexcept {
+            size_t current { admittedTaskCount.load() };
+            while (current < admissionCapacity) {
+                if (admittedTaskCount.compare_exchange_weak(current, current + 1)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void releaseAdmission(Task& task) noexcept {
+            if (task.holdsAdmission) {
+                task.holdsAdmission = false;
+                releaseAdmissionSlot();
+            }
+        }
+
+        void releaseAdmissionSlot() noexcept {
+            --admittedTaskCount;
+            // Pairs with awaitAdmission, so either it sees the room or we see it waiting.
+            if (blockedStarterCount > 0) {
+                admittedTaskCount.notify_one();
+            }
+        }
+
+        [[nodiscard]]
+        Admission admit() noexcept {
+            if (tryReserveAdmission()) {
+                return Admission::Admitted;
+            }
+            switch (overflowPolicy) {
+                case OverflowPolicy::Reject:
+                    break;
+                case OverflowPolicy::CallerRuns:
+                    return Admission::RunByCaller;
+                case OverflowPolicy::DropOldest:
+                    while (isPooled() && dropOldestQueuedTask()) {
+                        if (tryReserveAdmission()) {
+                            return Admission::Admitted;
+                        }
+                    }
+                    break;
+                case OverflowPolicy::Block:
+                    blockedStat.fetch_add(1, std::memory_order_relaxed);
+                    awaitAdmission();
+                    return Admission::Admitted;
+            }
+            rejectedStat.fetch_add(1, std::memory_order_relaxed);
+            return Admission::Rejected;
+        }
+
+        void awaitAdmission() noexcept {
+            ++blockedStarterCount;
+            while (!tryReserveAdmission()) {
+                // A worker runs queued tasks instead, which makes room.
+                if (runQueuedTask()) {
+                    continue;
+                }
+                size_t const current { admittedTaskCount };
+                if (current >= admissionCapacity) {
+                    admittedTaskCount.wait(current);
+                }
+            }
+            --blockedStarterCount;
+        }
+
+        // Only tasks holding an admission slot are dropped, those at the front of their queue.
+        bool dropOldestQueuedTask() noexcept {
+            std::shared_ptr<Task> task;
+            {
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                for (size_t i = 0; (i < priorityCount) && !task; ++i) {
+                    Queue<PendingTask>& queue { pendingTasks[i] };
+                    if (queue.empty() || !queue.front().task->holdsAdmission) {
+                        continue;
+                    }
+                    task = std::move(queue.front().task);
+                    queue.pop_front();
+                    --queuedTaskCount;
+                    --pendingTaskCount;
+                    if (i == static_cast<size_t>(Task::Priority::High)) {
+                        --pendingHighPriorityCount;
+                    }
+                }
+                for (auto const& node: nodes) {
+                    if (task) {
+                        break;
+                    }
+                    if (!node->tasks.empty() && node->tasks.front().task->holdsAdmission) {
+                        task = dequeueNodeTask(*node);
+                    }
+                }
+            }
+            for (size_t i = 0; (i < workers.size()) && !task && workStealing; ++i) {
+                Worker& worker { *workers[i] };
+                std::lock_guard<std::mutex> lock { worker.tasksLock };
+                if (!worker.tasks.empty() && worker.tasks.front()->holdsAdmission) {
+                    task = std::move(worker.tasks.front());
+                    worker.tasks.pop_front();
+                    --queuedTaskCount;
+                }
+            }
+            if (!task) {
+                return false;
+            }
+            droppedStat.fetch_add(1, std::memory_order_relaxed);
+            // Stopped without running, the starting thread is not held up by it.
+            releaseAdmission(*task);
+            task->abandon();
+            tasks.remove(task.get());
+            return true;
+        }
+
+        void runTask(std::shared_ptr<Task> const& task) noexcept {
+            // Pooled tasks make room as soon as they leave the queue.
+            releaseAdmission(*task);
+            // Tasks may run inline from within another task.
+            Task* const previousTask { Task::currentTask };
+            Task::currentTask = task.get();
+            markRun(*task);
+            beginHeartbeat(*task);
+            traceBegin(*task);
+            bool const done { task->run() };
+            traceEnd(*task);
+            Task::currentTask = previousTask;
+            if (!done) {
+                // Suspended, it will be enqueued again when resumed.
+                return;
+            }
+            endHeartbeat(*task);
+            recordMetrics(*task);
+            task->finished();
+            tasks.remove(task.get());
+        }
+
+        static void markRun(Task& task) noexcept {
+            // Only the first run counts, resumed coroutines run again.
+            if (task.recordsMetrics.load(std::memory_order_relaxed) && (task.runAt == std::chrono::steady_clock::time_point {})) {
+                task.runAt = std::chrono::steady_clock::now();
+            }
+        }
+
+        void beginHeartbeat(Task& task) const noexcept {
+            if (watchdogThreshold.count() > 0) {
+                task.heartbeat();
+            }
+        }
+
+        // A task that's done or suspended is not stuck. A suspending task ends it itself, before
+        // it can be resumed elsewhere and begin the next one.
+        void endHeartbeat(Task& task) const noexcept {
+            if (watchdogThreshold.count() > 0) {
+                task.lastHeartbeat.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Called periodically by the watchdog.
+        void reportStuckTasks(std::function<void(StuckTask const&)> const& onStuckTask) noexcept {
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            std::chrono::steady_clock::rep const stuckBefore { (now - watchdogThreshold).time_since_epoch().count() };
+            // Reported outside the registry's locks, and only once per heartbeat.
+            std::vector<std::shared_ptr<Task>> const stuckTasks {
+                tasks.collect([stuckBefore](Task& task) {
+                    std::chrono::steady_clock::rep const heartbeat { task.lastHeartbeat.load(std::memory_order_relaxed) };
+                    if ((heartbeat == 0) || (heartbeat > stuckBefore) || (heartbeat == task.reportedHeartbeat)) {
+                        return false;
+                    }
+                    task.reportedHeartbeat = heartbeat;
+                    return true;
+                })
+            };
+            for (auto const& task: stuckTasks) {
+                std::chrono::steady_clock::time_point const heartbeat {
+                    std::chrono::steady_clock::duration { task->reportedHeartbeat }
+                };
+                onStuckTask({ task->getId(), task->getState(), now - heartbeat });
+            }
+        }
+
+        void traceBegin(Task const& task) noexcept {
+            if (task.traceId != 0) {
+                tracer->begin("task", task.traceId);
+            }
+        }
+
+        void traceEnd(Task const& task) noexcept {
+            if (task.traceId != 0) {
+                tracer->end("task", task.traceId);
+            }
+        }
+
+        void recordMetrics(Task& task) noexcept {
+            if (!task.recordsMetrics.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            Task::Metrics& taskMetrics { task.metrics };
+            taskMetrics.queueLatency = task.runAt - task.queuedAt;
+            taskMetrics.runTime = now - task.runAt;
+            metrics->queueLatency.record(static_cast<uint64_t>(taskMetrics.queueLatency.count()));
+            metrics->runTime.record(static_cast<uint64_t>(taskMetrics.runTime.count()));
+            if (task.startedAt != std::chrono::steady_clock::time_point {}) {
+                taskMetrics.startLatency = task.startedAt - task.runAt;
+                metrics->startLatency.record(static_cast<uint64_t>(taskMetrics.startLatency.count()));
+            }
+            std::chrono::steady_clock::rep const cancelRequestedAt { task.cancelRequestedAt.load(std::memory_order_relaxed) };
+            if (cancelRequestedAt != 0) {
+                std::chrono::steady_clock::time_point const canceledAt { std::chrono::steady_clock::duration { cancelRequestedAt } };
+                taskMetrics.cancelLatency = now - canceledAt;
+                metrics->cancelLatency.record(static_cast<uint64_t>(taskMetrics.cancelLatency.count()));
+            }
+        }
+
+        // Runs a ready task, or else fires the next timer due by the given time, moving the clock
+        // to it. Returns false if there was nothing to run.
+        bool simulateStep(std::chrono::steady_clock::time_point const until = std::chrono::steady_clock::time_point::max()) noexcept {
+            std::unique_lock<std::mutex> lock { pendingTasksLock };
+            std::vector<std::shared_ptr<Task>>& readyTasks { simulation->readyTasks };
+            if (!readyTasks.empty()) {
+                // Plain modulo, so a seed gives the same interleaving with any standard library.
+                size_t const index { static_cast<size_t>(simulation->engine() % readyTasks.size()) };
+                std::shared_ptr<Task> const task { std::move(readyTasks[index]) };
+                readyTasks[index] = std::move(readyTasks.back());
+                readyTasks.pop_back();
+                --queuedTaskCount;
+                lock.unlock();
+                runTask(task);
+                return true;
+            }
+            while (!simulation->timers.empty() && (simulation->timers.begin()->first <= until)) {
+                auto timer { simulation->timers.extract(simulation->timers.begin()) };
+                if (timer.mapped()->canceled) {
+                    // Dropped outside the lock, its action may own anything.
+                    lock.unlock();
+                    timer = {};
+                    lock.lock();
+                    continue;
+                }
+                if (timer.key().time_since_epoch().count() > simulation->now.load(std::memory_order_relaxed)) {
+                    simulation->now.store(timer.key().time_since_epoch().count(), std::memory_order_relaxed);
+                }
+                lock.unlock();
+                timer.mapped()->fire();
+                return true;
+            }
+            return false;
+        }
+
+        ScheduledTaskRunner::Handle runAfter(std::chrono::steady_clock::duration const delay, std::function<void()>&& callback) noexcept {
+            if (simulation) {
+                std::chrono::steady_clock::time_point const deadline { now() + delay };
+                std::shared_ptr<ScheduledTaskRunner::Timer> timer {
+                    std::make_shared<ScheduledTaskRunner::Timer>(std::move(callback), ScheduledTaskRunner::Recurrence::Once,
+                        std::chrono::steady_clock::duration::zero(), deadline)
+                };
+                std::lock_guard<std::mutex> lock { pendingTasksLock };
+                simulation->timers.emplace(deadline, timer);
+                return ScheduledTaskRunner::Handle { std::move(timer) };
+            }
+            std::lock_guard<std::mutex> lock { timersLock };
+            if (timersShouldExit) {
+                return {};
+            }
+            if (!timers) {
+                timers = std::make_unique<ScheduledTaskRunner>();
             }
+            return timers->schedule(delay, std::move(callback));
         }
     };
 }
@@ -0,0 +1,228 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+namespace gb {
+
+    /**
+     * Records begin and end events from many threads, to view them as a timeline.
+     *
+     * <p>Each thread appends to its own buffer, so recording threads never contend with each
+     * other. Buffers are only read when writing the trace.
+     *
+     * <p>Buffers are rings of a fixed capacity, so a recorder can stay on in a long running
+     * process. Once a thread's buffer is full, each new event overwrites its oldest one, and the
+     * trace only has the most recent events of each thread.
+     *
+     * <p>There are at most maxThreads buffers, so memory stays bounded by maxThreads times
+     * maxEventsPerThread events, even when each task runs on its own thread. Past that, a new
+     * thread takes over the buffer whose last event is oldest, usually one of a thread that has
+     * exited, and its events are dropped. If that thread records again, it takes over another.
+     *
+     * <p>The trace is written in the Chrome trace event format, which chrome://tracing and
+     * Perfetto (ui.perfetto.dev) can open.
+     */
+    class TraceRecorder {
+    private:
+        struct Event {
+            char const* name;
+            uint64_t id;
+            std::chrono::steady_clock::time_point time;
+            char phase;
+        };
+
+        struct Buffer {
+            std::mutex lock;
+            // Owner, which changes when the buffer is taken over.
+            std::thread::id thread;
+            uint64_t threadId;
+            std::vector<Event> events;
+            // Oldest event, once full.
+            size_t oldest { 0 };
+
+            Buffer(std::thread::id const thread, uint64_t const threadId) noexcept :
+                thread(thread), threadId(threadId) {}
+
+            // Must be called with lock held.
+            [[nodiscard]]
+            std::chrono::steady_clock::time_point getLastEventTime() const noexcept {
+                if (events.empty()) {
+                    return std::chrono::steady_clock::time_point::min();
+                }
+                return events[(oldest + events.size() - 1) % events.size()].time;
+            }
+        };
+
+        static inline std::atomic<uint64_t> nextRecorderId { 1 };
+        // Buffer of the calling thread, for the recorder it was last used with.
+        static inline thread_local uint64_t threadRecorderId { 0 };
+        static inline thread_local Buffer* threadBuffer { nullptr };
+
+        // Recorders never share an id, even if one is created where another was destroyed.
+        uint64_t const recorderId { nextRecorderId.fetch_add(1, std::memory_order_relaxed) };
+        size_t const maxEventsPerThread;
+        size_t const maxThreads;
+        std::chrono::steady_clock::time_point const startTime { std::chrono::steady_clock::now() };
+        std::atomic<uint64_t> nextId { 1 };
+        std::mutex buffersLock;
+        std::vector<std::unique_ptr<Buffer>> buffers;
+        std::unordered_map<std::thread::id, Buffer*> threadBuffers;
+        uint64_t nextThreadId { 1 };
+
+    public:
+        /**
+         * Creates a recorder.
+         *
+         * @param maxEventsPerThread Events kept for each thread, the most recent ones. At least 1.
+         * @param maxThreads Threads whose events are kept at once. At least 1.
+         */
+        explicit TraceRecorder(size_t const maxEventsPerThread = 65536, size_t const maxThreads = 256) noexcept :
+            maxEventsPerThread(std::max(maxEventsPerThread, size_t { 1 })), maxThreads(std::max(maxThreads, size_t { 1 })) {}
+
+        TraceRecorder(TraceRecorder const&) = delete;
+
+        TraceRecorder& operator=(TraceRecorder const&) = delete;
+
+        /**
+         * Returns a new id, to tell apart what events are about.
+         *
+         * @return A new id, never 0.
+         */
+        [[nodiscard]]
+        uint64_t newId() noexcept {
+            return nextId.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Records the beginning of a slice on the calling thread.
+         *
+         * <p>Slices on a thread must end in the reverse order they began.
+         *
+         * @param name Name of the slice. It must outlive the recorder, like a string literal.
+         * @param id Id of what the slice is about.
+         */
+        void begin(char const* const name, uint64_t const id) noexcept {
+            record(name, id, 'B');
+        }
+
+        /**
+         * Records the end of the last slice that began on the calling thread.
+         *
+         * @param name Name of the slice. It must outlive the recorder, like a string literal.
+         * @param id Id of what the slice is about.
+         */
+        void end(char const* const name, uint64_t const id) noexcept {
+            record(name, id, 'E');
+        }
+
+        /**
+         * Writes the events kept so far as Chrome trace event JSON, oldest first.
+         *
+         * <p>Once a thread's oldest events were overwritten, its trace may start with ends of
+         * slices whose beginning is gone.
+         *
+         * @param out Stream to write to.
+         */
+        void write(std::ostream& out) noexcept {
+            std::lock_guard<std::mutex> buffersGuard { buffersLock };
+            std::ios_base::fmtflags const flags { out.flags() };
+            out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+            bool first { true };
+            for (auto const& buffer: buffers) {
+                std::lock_guard<std::mutex> lock { buffer->lock };
+                out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" <<
+                    buffer->threadId << ",\"args\":{\"name\":\"thread " << buffer->threadId << "\"}}";
+                first = false;
+                std::vector<Event> const& events { buffer->events };
+                for (size_t i = 0; i < events.size(); ++i) {
+                    Event const& event { events[(buffer->oldest + i) % events.size()] };
+                    double const microseconds {
+                        std::chrono::duration<double, std::micro> { event.time - startTime }.count()
+                    };
+                    out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" <<
+                        buffer->threadId << ",\"ts\":" << std::fixed << microseconds << ",\"args\":{\"id\":" <<
+                        event.id << "}}";
+                }
+            }
+            out << "\n]}\n";
+            out.flags(flags);
+        }
+
+    private:
+        void record(char const* const name, uint64_t const id, char const phase) noexcept {
+            std::chrono::steady_clock::time_point const now { std::chrono::steady_clock::now() };
+            std::thread::id const thread { std::this_thread::get_id() };
+            Buffer* owned { &getThreadBuffer(thread) };
+            std::unique_lock<std::mutex> lock { owned->lock };
+            while (owned->thread != thread) {
+                // Taken over by another thread.
+                lock.unlock();
+                threadRecorderId = 0;
+                owned = &getThreadBuffer(thread);
+                lock = std::unique_lock<std::mutex> { owned->lock };
+            }
+            Buffer& buffer { *owned };
+            if (buffer.events.size() < maxEventsPerThread) {
+                buffer.events.push_back({ name, id, now, phase });
+                return;
+            }
+            buffer.events[buffer.oldest] = { name, id, now, phase };
+            buffer.oldest = (buffer.oldest + 1) % buffer.events.size();
+        }
+
+        Buffer& getThreadBuffer(std::thread::id const thread) noexcept {
+            if (threadRecorderId != recorderId) {
+                // The thread may have recorded here before, and then on another recorder.
+                std::lock_guard<std::mutex> lock { buffersLock };
+                auto const it { threadBuffers.find(thread) };
+                if (it != threadBuffers.end()) {
+                    threadBuffer = it->second;
+                } else if (buffers.size() < maxThreads) {
+                    buffers.push_back(std::make_unique<Buffer>(thread, nextThreadId++));
+                    threadBuffer = buffers.back().get();
+                    threadBuffers.emplace(thread, threadBuffer);
+                } else {
+                    threadBuffer = takeOverBuffer(thread);
+                }
+                threadRecorderId = recorderId;
+            }
+            return *threadBuffer;
+        }
+
+        // Gives the buffer whose last event is oldest to the thread. Must be called with
+        // buffersLock held.
+        [[nodiscard]]
+        Buffer* takeOverBuffer(std::thread::id const thread) noexcept {
+            Buffer* oldest { nullptr };
+            std::chrono::steady_clock::time_point oldestTime { std::chrono::steady_clock::time_point::max() };
+            for (auto const& buffer: buffers) {
+                std::lock_guard<std::mutex> lock { buffer->lock };
+                std::chrono::steady_clock::time_point const time { buffer->getLastEventTime() };
+                if ((oldest == nullptr) || (time < oldestTime)) {
+                    oldest = buffer.get();
+                    oldestTime = time;
+                }
+            }
+            std::lock_guard<std::mutex> lock { oldest->lock };
+            threadBuffers.erase(oldest->thread);
+            threadBuffers.emplace(thread, oldest);
+            oldest->thread = thread;
+            oldest->threadId = nextThreadId++;
+            oldest->events.clear();
+            oldest->oldest = 0;
+            return oldest;
+        }
+    };
+}
@@ -0,0 +1,235 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "TaskRunner.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <concepts>
+#include <thread>
+
+namespace gb {
+
+    /**
+     * Index range shared by the participants of a parallel algorithm, handed out in chunks.
+     *
+     * <p>Chunks start large and shrink as the range runs out (guided scheduling), so participants
+     * that get held up don't leave the rest idle at the tail.
+     *
+     * <p>Don't use directly. Use parallelFor, parallelReduce or parallelTransform.
+     *
+     * @tparam I Index type.
+     */
+    template<std::integral I>
+    class ParallelChunks {
+    private:
+        I const end;
+        I const grain;
+        I const divisor;
+        std::atomic<I> next;
+        std::atomic<I> remaining;
+
+    public:
+        ParallelChunks(I const begin, I const end, I const grain, size_t const participants) noexcept :
+            end(end), grain(std::max(grain, I { 1 })), divisor(static_cast<I>(participants * 2)),
+            next(begin), remaining(end - begin) {}
+
+        /**
+         * Claims the next chunk.
+         *
+         * @param chunkBegin Set to the beginning of the chunk.
+         * @param chunkEnd Set to the end of the chunk.
+         * @return False if the whole range has been handed out.
+         */
+        bool claim(I& chunkBegin, I& chunkEnd) noexcept {
+            I begin { next.load(std::memory_order_relaxed) };
+            do {
+                if (begin >= end) {
+                    return false;
+                }
+                I const size { std::max(grain, static_cast<I>((end - begin) / divisor)) };
+                chunkEnd = end - begin > size ? begin + size : end;
+            } while (!next.compare_exchange_weak(begin, chunkEnd, std::memory_order_relaxed));
+            chunkBegin = begin;
+            return true;
+        }
+
+        /**
+         * Marks a claimed chunk as done.
+         *
+         * @param chunkBegin Beginning of the chunk.
+         * @param chunkEnd End of the chunk.
+         */
+        void done(I const chunkBegin, I const chunkEnd) noexcept {
+            if (remaining.fetch_sub(chunkEnd - chunkBegin, std::memory_order_acq_rel) == chunkEnd - chunkBegin) {
+                remaining.notify_all();
+            }
+        }
+
+        /**
+         * Blocks the calling thread until every chunk is done.
+         */
+        void awaitDone() const noexcept {
+            for (I current = remaining.load(std::memory_order_acquire); current > 0; current = remaining.load(std::memory_order_acquire)) {
+                remaining.wait(current, std::memory_order_acquire);
+            }
+        }
+
+        /**
+         * Runs the given chunk body on the runner's workers and the calling thread, until every
+         * chunk is done.
+         *
+         * <p>Helpers that start after the range has been handed out exit right away, so the
+         * calling thread never waits on queued helpers. This makes it safe to nest.
+         *
+         * @tparam F Chunk body type.
+         * @param chunks Shared chunks.
+         * @param runner Runner for the helpers.
+         * @param helperCount Number of helpers to submit.
+         * @param body Function that takes the beginning and end of a chunk.
+         */
+        template<typename F>
+        static void run(std::shared_ptr<ParallelChunks> const& chunks, TaskRunner& runner,
+            size_t const helperCount, F& body) noexcept {
+            auto const work { [chunks, &body]{
+                I chunkBegin;
+                I chunkEnd;
+                while (chunks->claim(chunkBegin, chunkEnd)) {
+                    body(chunkBegin, chunkEnd);
+                    chunks->done(chunkBegin, chunkEnd);
+                }
+            } };
+            for (size_t i = 0; i < helperCount; ++i) {
+                if (!runner.submit(work).isValid()) {
+                    break;
+                }
+            }
+            work();
+            chunks->awaitDone();
+        }
+
+        /**
+         * Returns the number of helpers worth submitting for a range.
+         *
+         * @param runner Runner for the helpers.
+         * @param size Size of the range.
+         * @param grain Minimum chunk size.
+         * @return The number of helpers.
+         */
+        [[nodiscard]]
+        static size_t helperCount(TaskRunner const& runner, I const size, I const grain) noexcept {
+            size_t const threads {
+                runner.isPooled() ? runner.getWorkerCount() : std::max(std::thread::hardware_concurrency(), 1u)
+            };
+            size_t const chunkCount { static_cast<size_t>((size + std::max(grain, I { 1 }) - 1) / std::max(grain, I { 1 })) };
+            // The calling thread takes part too.
+            return std::min(threads, chunkCount) - (chunkCount > 0 ? 1 : 0);
+        }
+    };
+
+    /**
+     * Calls a function for every index in a range, in parallel on the runner's workers.
+     *
+     * <p>The calling thread takes part, and returns when every index is done.
+     *
+     * @tparam I Index type.
+     * @tparam F Function type.
+     * @param runner Runner whose workers take part.
+     * @param begin First index.
+     * @param end One past the last index.
+     * @param grain Minimum number of indices each worker takes at once.
+     * @param fn Function that takes an index.
+     */
+    template<std::integral I, typename F>
+    void parallelFor(TaskRunner& runner, I const begin, I const end, I const grain, F&& fn) noexcept {
+        if (begin >= end) {
+            return;
+        }
+        size_t const helperCount { ParallelChunks<I>::helperCount(runner, end - begin, grain) };
+        std::shared_ptr<ParallelChunks<I>> const chunks {
+            std::make_shared<ParallelChunks<I>>(begin, end, grain, helperCount + 1)
+        };
+        auto body { [&fn](I const chunkBegin, I const chunkEnd) {
+            for (I i = chunkBegin; i < chunkEnd; ++i) {
+                fn(i);
+            }
+        } };
+        ParallelChunks<I>::run(chunks, runner, helperCount, body);
+    }
+
+    /**
+     * Reduces a range of indices to a single value, in parallel on the runner's workers.
+     *
+     * <p>Each chunk is folded from the identity, and the chunk results are then combined in
+     * index order. So the combine function must be associative, but it doesn't need to be
+     * commutative.
+     *
+     * @tparam I Index type.
+     * @tparam T Value type.
+     * @tparam F Fold function type.
+     * @tparam C Combine function type.
+     * @param runner Runner whose workers take part.
+     * @param begin First index.
+     * @param end One past the last index.
+     * @param grain Minimum number of indices each worker takes at once.
+     * @param identity Identity value of the combine function.
+     * @param fold Function that takes an accumulated value and an index, and returns the new accumulated value.
+     * @param combine Function that takes two values and returns their combination.
+     * @return The reduced value.
+     */
+    template<std::integral I, typename T, typename F, typename C>
+    [[nodiscard]]
+    T parallelReduce(TaskRunner& runner, I const begin, I const end, I const grain, T const& identity, F&& fold, C&& combine) noexcept {
+        if (begin >= end) {
+            return identity;
+        }
+        size_t const helperCount { ParallelChunks<I>::helperCount(runner, end - begin, grain) };
+        std::shared_ptr<ParallelChunks<I>> const chunks {
+            std::make_shared<ParallelChunks<I>>(begin, end, grain, helperCount + 1)
+        };
+        std::mutex resultsLock;
+        std::vector<std::pair<I, T>> results;
+        auto body { [&](I const chunkBegin, I const chunkEnd) {
+            T value { identity };
+            for (I i = chunkBegin; i < chunkEnd; ++i) {
+                value = fold(std::move(value), i);
+            }
+            std::lock_guard<std::mutex> lock { resultsLock };
+            results.emplace_back(chunkBegin, std::move(value));
+        } };
+        ParallelChunks<I>::run(chunks, runner, helperCount, body);
+        std::ranges::sort(results, {}, &std::pair<I, T>::first);
+        T value { identity };
+        for (auto& result: results) {
+            value = combine(std::move(value), std::move(result.second));
+        }
+        return value;
+    }
+
+    /**
+     * Applies a function to every element of a range, in parallel on the runner's workers, and
+     * writes the results to an output.
+     *
+     * @tparam R Input range type.
+     * @tparam O Output iterator type.
+     * @tparam F Function type.
+     * @param runner Runner whose workers take part.
+     * @param input Input range.
+     * @param output Beginning of the output, with room for as many elements as the input.
+     * @param grain Minimum number of elements each worker takes at once.
+     * @param fn Function that takes an input element and returns an output element.
+     */
+    template<std::ranges::random_access_range R, std::random_access_iterator O, typename F>
+    void parallelTransform(TaskRunner& runner, R&& input, O const output, size_t const grain, F&& fn) noexcept {
+        auto const first { std::ranges::begin(input) };
+        parallelFor(runner, size_t { 0 }, static_cast<size_t>(std::ranges::distance(input)), grain, [&](size_t const i) {
+            output[i] = fn(first[i]);
+        });
+    }
+}
@@ -0,0 +1,118 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+TEST(Channel, roundsUpCapacity) {
+    gb::Channel<int> const channel { 5 };
+    ASSERT_EQ(channel.capacity(), 8);
+}
+
+TEST(Channel, canTryPushAndPop) {
+    gb::Channel<std::string> channel { 2 };
+    ASSERT_TRUE(channel.tryPush("one"));
+    ASSERT_TRUE(channel.tryPush("two"));
+    std::string three { "three" };
+    ASSERT_FALSE(channel.tryPush(std::move(three)));
+    ASSERT_EQ(three, "three");
+    ASSERT_EQ(channel.size(), 2);
+    ASSERT_EQ(channel.tryPop(), "one");
+    ASSERT_EQ(channel.tryPop(), "two");
+    ASSERT_FALSE(channel.tryPop());
+}
+
+TEST(Channel, canDrainAfterClose) {
+    gb::Channel<int> channel { 4 };
+    channel.push(1);
+    channel.push(2);
+    channel.close();
+    ASSERT_TRUE(channel.isClosed());
+    ASSERT_FALSE(channel.push(3));
+    ASSERT_EQ(channel.pop(), 1);
+    ASSERT_EQ(channel.pop(), 2);
+    ASSERT_FALSE(channel.pop());
+}
+
+TEST(Channel, closeWakesBlockedConsumers) {
+    gb::Channel<int> channel { 4 };
+    std::thread consumer { [&]{ ASSERT_FALSE(channel.pop()); } };
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    channel.close();
+    consumer.join();
+}
+
+TEST(Channel, blocksProducersWhileFull) {
+    gb::Channel<int> channel { 2 };
+    channel.push(1);
+    channel.push(2);
+    std::atomic<bool> pushed { false };
+    std::thread producer { [&]{
+        channel.push(3);
+        pushed = true;
+    } };
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(pushed);
+    ASSERT_EQ(channel.pop(), 1);
+    producer.join();
+    ASSERT_TRUE(pushed);
+}
+
+TEST(Channel, canPassValuesBetweenTasks) {
+    gb::TaskRunner runner { 8 };
+    gb::Channel<int> channel { 16 };
+    constexpr int producerCount { 4 };
+    constexpr int valuesPerProducer { 10000 };
+    std::vector<gb::Future<void>> producers;
+    for (int p = 0; p < producerCount; ++p) {
+        producers.push_back(runner.submit([&]{
+            for (int i = 1; i <= valuesPerProducer; ++i) {
+                channel.push(i);
+            }
+        }));
+    }
+    std::vector<gb::Future<long>> consumers;
+    for (int c = 0; c < 4; ++c) {
+        consumers.push_back(runner.submit([&]{
+            long sum { 0 };
+            while (std::optional<int> const value { channel.pop() }) {
+                sum += *value;
+            }
+            return sum;
+        }));
+    }
+    for (auto const& producer: producers) {
+        producer.wait();
+    }
+    channel.close();
+    long total { 0 };
+    for (auto const& consumer: consumers) {
+        total += consumer.get();
+    }
+    ASSERT_EQ(total, static_cast<long>(producerCount) * valuesPerProducer * (valuesPerProducer + 1) / 2);
+}
+
+class ChannelConsumerTask : public gb::Task {
+public:
+    gb::Channel<int>& channel;
+    std::atomic<bool> gotValue { true };
+
+    explicit ChannelConsumerTask(gb::Channel<int>& channel) noexcept : channel(channel) {}
+
+protected:
+    void action() noexcept override {
+        started();
+        gotValue = channel.pop().has_value();
+    }
+};
+
+TEST(Channel, cancelWakesBlockedTask) {
+    gb::TaskRunner runner { 1 };
+    gb::Channel<int> channel { 4 };
+    std::shared_ptr<ChannelConsumerTask> const task { std::make_shared<ChannelConsumerTask>(channel) };
+    runner.start(task);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    task->cancel();
+    task->awaitStop();
+    ASSERT_FALSE(task->gotValue);
+}
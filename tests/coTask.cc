@@ -0,0 +1,92 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+gb::CoTask<int> square(int const value) {
+    co_await gb::coSleep(std::chrono::milliseconds(10));
+    co_return value * value;
+}
+
+gb::CoTask<int> sumOfSquares(int const count) {
+    int sum { 0 };
+    for (int i = 1; i <= count; ++i) {
+        sum += co_await square(i);
+    }
+    co_return sum;
+}
+
+gb::CoTask<> untilCanceled(std::atomic<int>& loops) {
+    while (true) {
+        bool const shouldCancel { co_await gb::coShouldCancel() };
+        if (shouldCancel) {
+            break;
+        }
+        ++loops;
+        co_await gb::coSleep(std::chrono::milliseconds(5));
+    }
+}
+
+TEST(CoTask, canRunCoroutine) {
+    gb::TaskRunner runner { 2 };
+    gb::CoTask<int> const task { square(7) };
+    ASSERT_TRUE(runner.start(task));
+    task.awaitStop();
+    ASSERT_EQ(task.getResult(), 49);
+}
+
+TEST(CoTask, canAwaitOtherCoroutines) {
+    gb::TaskRunner runner { 2 };
+    gb::CoTask<int> const task { sumOfSquares(4) };
+    runner.start(task);
+    task.awaitStop();
+    ASSERT_EQ(task.getResult(), 30);
+}
+
+TEST(CoTask, canRunOnUnpooledRunner) {
+    gb::TaskRunner runner;
+    gb::CoTask<int> const task { sumOfSquares(3) };
+    runner.start(task);
+    task.awaitStop();
+    ASSERT_EQ(task.getResult(), 14);
+}
+
+TEST(CoTask, canCancelCoroutine) {
+    gb::TaskRunner runner { 1 };
+    std::atomic<int> loops { 0 };
+    gb::CoTask<> const task { untilCanceled(loops) };
+    runner.start(task);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    task.cancel();
+    task.awaitStop();
+    ASSERT_GT(loops, 0);
+}
+
+TEST(CoTask, canKeepManyCoroutinesOnFewThreads) {
+    gb::TaskRunner runner { 2 };
+    std::vector<gb::CoTask<int>> tasks;
+    for (int i = 0; i < 1000; ++i) {
+        tasks.push_back(square(i));
+        ASSERT_TRUE(runner.start(tasks.back()));
+    }
+    runner.awaitAll();
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(tasks[i].getResult(), i * i);
+    }
+}
+
+gb::CoTask<> sleepLong() {
+    co_await gb::coSleep(std::chrono::seconds(10));
+}
+
+TEST(CoTask, cancelEndsSleepEarly) {
+    gb::TaskRunner runner { 1 };
+    gb::CoTask<> const task { sleepLong() };
+    runner.start(task);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto const start { std::chrono::steady_clock::now() };
+    task.cancel();
+    task.awaitStop();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
@@ -0,0 +1,51 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+TEST(CpuTopology, canParseCpuList) {
+    ASSERT_EQ(gb::CpuTopology::parseCpuList("0-3,8,10-11\n"), (std::vector<unsigned> { 0, 1, 2, 3, 8, 10, 11 }));
+    ASSERT_EQ(gb::CpuTopology::parseCpuList("5"), (std::vector<unsigned> { 5 }));
+    ASSERT_TRUE(gb::CpuTopology::parseCpuList("").empty());
+}
+
+TEST(CpuTopology, stopsAtMalformedCpuRange) {
+    ASSERT_EQ(gb::CpuTopology::parseCpuList("0-1,5-3,8"), (std::vector<unsigned> { 0, 1 }));
+    ASSERT_EQ(gb::CpuTopology::parseCpuList("2,0-4294967295"), (std::vector<unsigned> { 2 }));
+    ASSERT_TRUE(gb::CpuTopology::parseCpuList(std::to_string(gb::CpuTopology::maxCpuCount)).empty());
+}
+
+// Nodes without CPUs the process may run on are kept, so node ids don't shift.
+size_t firstNodeWithCpus(gb::CpuTopology const& topology) {
+    for (size_t node = 0; node < topology.getNodeCount(); ++node) {
+        if (!topology.getCpus(node).empty()) {
+            return node;
+        }
+    }
+    return topology.getNodeCount();
+}
+
+TEST(CpuTopology, detectsAtLeastOneNodeWithCpus) {
+    gb::CpuTopology const topology { gb::CpuTopology::detect() };
+    ASSERT_GE(topology.getNodeCount(), 1);
+    ASSERT_LT(firstNodeWithCpus(topology), topology.getNodeCount());
+}
+
+#ifdef __linux__
+TEST(CpuTopology, canPinThread) {
+    gb::CpuTopology const topology { gb::CpuTopology::detect() };
+    unsigned const cpu { topology.getCpus(firstNodeWithCpus(topology)).front() };
+    bool pinned { false };
+    int ranOn { -1 };
+    std::thread thread {
+        [&]{
+            pinned = gb::CpuTopology::pinCurrentThread(std::span<unsigned const> { &cpu, 1 });
+            ranOn = sched_getcpu();
+        }
+    };
+    thread.join();
+    ASSERT_TRUE(pinned);
+    ASSERT_EQ(ranOn, static_cast<int>(cpu));
+}
+#endif
@@ -0,0 +1,73 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+TEST(Future, canSubmitFunction) {
+    gb::TaskRunner runner { 2 };
+    gb::Future<int> const future { runner.submit([]{ return 6 * 7; }) };
+    ASSERT_TRUE(future.isValid());
+    ASSERT_EQ(future.get(), 42);
+    ASSERT_TRUE(future.isReady());
+}
+
+TEST(Future, canChainContinuations) {
+    gb::TaskRunner runner { 2 };
+    gb::Future<std::string> const future {
+        runner.submit([]{ return 21; })
+            .then([](int const value) { return value * 2; })
+            .then([](int const value) { return std::to_string(value); })
+    };
+    ASSERT_EQ(future.get(), "42");
+}
+
+TEST(Future, runsContinuationOnCompletingThread) {
+    gb::TaskRunner runner { 1 };
+    std::atomic<bool> gate { false };
+    gb::Future<std::thread::id> const worker {
+        runner.submit([&gate]{
+            gate.wait(false);
+            return std::this_thread::get_id();
+        })
+    };
+    gb::Future<std::thread::id> const continuation { worker.then([](std::thread::id const&) { return std::this_thread::get_id(); }) };
+    gate = true;
+    gate.notify_all();
+    ASSERT_EQ(continuation.get(), worker.get());
+}
+
+TEST(Future, canSubmitVoidFunction) {
+    gb::TaskRunner runner;
+    std::atomic<int> count { 0 };
+    gb::Future<void> const future { runner.submit([&count]{ ++count; }).then([&count]{ ++count; }) };
+    future.wait();
+    ASSERT_EQ(count, 2);
+}
+
+TEST(Future, isInvalidOnInactiveRunner) {
+    gb::TaskRunner runner { 1 };
+    runner.shutdown();
+    ASSERT_FALSE(runner.submit([]{ return 1; }).isValid());
+}
+
+TEST(Future, invalidFutureDoesNotWait) {
+    gb::Future<int> const future;
+    future.wait();
+    ASSERT_FALSE(future.isReady());
+    bool ran { false };
+    ASSERT_FALSE(future.then([&ran](int const value) { ran = true; return value; }).isValid());
+    ASSERT_FALSE(ran);
+}
+
+TEST(Future, canceledFutureSkipsContinuations) {
+    gb::TaskRunner runner { gb::TaskRunner::SimulationOptions {} };
+    bool ran { false };
+    gb::Future<int> const future { runner.submit([]{ return 1; }) };
+    gb::Future<int> const next { future.then([&ran](int const value) { ran = true; return value + 1; }) };
+    runner.cancelAll();
+    runner.runUntilIdle();
+    ASSERT_TRUE(future.isCanceled());
+    ASSERT_TRUE(next.isCanceled());
+    ASSERT_FALSE(ran);
+}
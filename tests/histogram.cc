@@ -0,0 +1,56 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+TEST(Histogram, isEmptyWithoutValues) {
+    gb::Histogram const histogram;
+    gb::Histogram::Snapshot const snapshot { histogram.snapshot() };
+    ASSERT_EQ(snapshot.count, 0);
+    ASSERT_EQ(snapshot.min, 0);
+    ASSERT_EQ(snapshot.max, 0);
+    ASSERT_EQ(snapshot.percentile(50), 0);
+}
+
+TEST(Histogram, isExactForSmallValues) {
+    gb::Histogram histogram;
+    for (uint64_t i = 1; i <= 50; ++i) {
+        histogram.record(i);
+    }
+    gb::Histogram::Snapshot const snapshot { histogram.snapshot() };
+    ASSERT_EQ(snapshot.count, 50);
+    ASSERT_EQ(snapshot.min, 1);
+    ASSERT_EQ(snapshot.max, 50);
+    ASSERT_EQ(snapshot.percentile(50), 25);
+    ASSERT_EQ(snapshot.percentile(100), 50);
+    ASSERT_DOUBLE_EQ(snapshot.mean(), 25.5);
+}
+
+TEST(Histogram, isCloseForLargeValues) {
+    gb::Histogram histogram;
+    for (uint64_t i = 1; i <= 100000; ++i) {
+        histogram.record(i * 1000);
+    }
+    gb::Histogram::Snapshot const snapshot { histogram.snapshot() };
+    ASSERT_NEAR(static_cast<double>(snapshot.percentile(50)), 50000000.0, 50000000.0 * 0.03);
+    ASSERT_NEAR(static_cast<double>(snapshot.percentile(99)), 99000000.0, 99000000.0 * 0.03);
+    ASSERT_EQ(snapshot.max, 100000000);
+    ASSERT_EQ(snapshot.percentile(100), 100000000);
+}
+
+TEST(Histogram, canRecordFromManyThreads) {
+    gb::Histogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]{
+            for (uint64_t i = 0; i < 10000; ++i) {
+                histogram.record(i);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    ASSERT_EQ(histogram.snapshot().count, 40000);
+}
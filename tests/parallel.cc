@@ -0,0 +1,70 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+TEST(Parallel, canRunForEveryIndex) {
+    gb::TaskRunner runner { 4 };
+    std::vector<std::atomic<int>> visits(10000);
+    gb::parallelFor(runner, 0, 10000, 16, [&](int const i) {
+        ++visits[i];
+    });
+    for (auto const& count: visits) {
+        ASSERT_EQ(count, 1);
+    }
+}
+
+TEST(Parallel, canRunForEmptyRange) {
+    gb::TaskRunner runner { 2 };
+    bool called { false };
+    gb::parallelFor(runner, 5, 5, 1, [&](int const) { called = true; });
+    ASSERT_FALSE(called);
+}
+
+TEST(Parallel, canRunForOnUnpooledRunner) {
+    gb::TaskRunner runner;
+    std::atomic<long> sum { 0 };
+    gb::parallelFor(runner, 1L, 1001L, 100L, [&](long const i) { sum += i; });
+    ASSERT_EQ(sum, 500500);
+}
+
+TEST(Parallel, canNestParallelFor) {
+    gb::TaskRunner runner { 2 };
+    std::atomic<int> count { 0 };
+    gb::parallelFor(runner, 0, 8, 1, [&](int const) {
+        gb::parallelFor(runner, 0, 100, 1, [&](int const) { ++count; });
+    });
+    ASSERT_EQ(count, 800);
+}
+
+TEST(Parallel, canReduceInOrder) {
+    gb::TaskRunner runner { 4 };
+    std::string const result {
+        gb::parallelReduce(runner, 0, 26, 1, std::string {},
+            [](std::string&& value, int const i) { return value + static_cast<char>('a' + i); },
+            [](std::string&& a, std::string&& b) { return a + b; })
+    };
+    ASSERT_EQ(result, "abcdefghijklmnopqrstuvwxyz");
+}
+
+TEST(Parallel, canReduceSum) {
+    gb::TaskRunner runner { 4 };
+    long const sum {
+        gb::parallelReduce(runner, 0L, 100000L, 64L, 0L,
+            [](long const value, long const i) { return value + i; },
+            [](long const a, long const b) { return a + b; })
+    };
+    ASSERT_EQ(sum, 4999950000L);
+}
+
+TEST(Parallel, canTransform) {
+    gb::TaskRunner runner { 4 };
+    std::vector<int> input(1000);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<int> output(input.size());
+    gb::parallelTransform(runner, input, output.begin(), 32, [](int const value) { return value * 2; });
+    for (size_t i = 0; i < input.size(); ++i) {
+        ASSERT_EQ(output[i], input[i] * 2);
+    }
+}
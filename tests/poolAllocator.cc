@@ -0,0 +1,114 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+#include <deque>
+
+TEST(PoolAllocator, reusesFreedBlocks) {
+    gb::PoolAllocator<std::array<char, 100>> allocator;
+    auto* const first { allocator.allocate(1) };
+    allocator.deallocate(first, 1);
+    auto* const second { allocator.allocate(1) };
+    ASSERT_EQ(first, second);
+    allocator.deallocate(second, 1);
+}
+
+TEST(PoolAllocator, reusesBlocksFreedByOtherThreads) {
+    gb::PoolAllocator<std::array<char, 200>> allocator;
+    std::vector<std::array<char, 200>*> blocks;
+    for (int i = 0; i < 1000; ++i) {
+        blocks.push_back(allocator.allocate(1));
+    }
+    std::thread freeing {
+        [&]{
+            for (auto* const block: blocks) {
+                allocator.deallocate(block, 1);
+            }
+        }
+    };
+    freeing.join();
+    // The freeing thread handed its blocks over when it exited.
+    auto* const reused { allocator.allocate(1) };
+    ASSERT_NE(std::ranges::find(blocks, reused), blocks.end());
+    allocator.deallocate(reused, 1);
+}
+
+TEST(PoolAllocator, returnsFreeBlocksToTheHeap) {
+    gb::PoolAllocator<std::array<char, 300>> allocator;
+    std::vector<std::array<char, 300>*> blocks;
+    for (int i = 0; i < 5000; ++i) {
+        blocks.push_back(allocator.allocate(1));
+    }
+    std::thread freeing {
+        [&]{
+            for (auto* const block: blocks) {
+                allocator.deallocate(block, 1);
+            }
+        }
+    };
+    freeing.join();
+    // Past the shared capacity blocks went back to the heap, and trim returns the rest.
+    gb::BlockPool::trim();
+    auto* const block { allocator.allocate(1) };
+    (*block)[299] = 1;
+    allocator.deallocate(block, 1);
+}
+
+// Frees its block after the thread's pool lists are gone.
+struct LateFree {
+    std::array<char, 400>* block { nullptr };
+
+    ~LateFree() noexcept {
+        if (block != nullptr) {
+            gb::PoolAllocator<std::array<char, 400>> {}.deallocate(block, 1);
+        }
+    }
+};
+
+TEST(PoolAllocator, takesBlocksFreedDuringThreadExit) {
+    gb::PoolAllocator<std::array<char, 400>> allocator;
+    std::array<char, 400>* freed { nullptr };
+    std::thread exiting {
+        [&]{
+            // Constructed before the pool lists, so it's destroyed after them.
+            static thread_local LateFree lateFree;
+            lateFree.block = allocator.allocate(1);
+            freed = lateFree.block;
+        }
+    };
+    exiting.join();
+    std::vector<std::array<char, 400>*> blocks;
+    for (int i = 0; i < 100; ++i) {
+        blocks.push_back(allocator.allocate(1));
+    }
+    ASSERT_NE(std::ranges::find(blocks, freed), blocks.end());
+    for (auto* const block: blocks) {
+        allocator.deallocate(block, 1);
+    }
+}
+
+TEST(PoolAllocator, canAllocateLargeBlocks) {
+    gb::PoolAllocator<std::array<char, 4096>> allocator;
+    auto* const block { allocator.allocate(1) };
+    (*block)[4095] = 1;
+    allocator.deallocate(block, 1);
+}
+
+TEST(PoolAllocator, canBackContainers) {
+    std::deque<int, gb::PoolAllocator<int>> values;
+    for (int i = 0; i < 10000; ++i) {
+        values.push_back(i);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_EQ(values.front(), i);
+        values.pop_front();
+    }
+}
+
+TEST(PoolAllocator, canBackSharedPointers) {
+    std::shared_ptr<int> const value { std::allocate_shared<int>(gb::PoolAllocator<int> {}, 42) };
+    std::weak_ptr<int> const weak { value };
+    ASSERT_EQ(*value, 42);
+    ASSERT_EQ(weak.lock(), value);
+}
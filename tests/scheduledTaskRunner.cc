@@ -0,0 +1,175 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+class ScheduledTaskRunnerTest : public ::testing::Test {
+protected:
+    gb::ScheduledTaskRunner* runner { nullptr };
+
+    void SetUp() override {
+        runner = new gb::ScheduledTaskRunner();
+    }
+
+    void TearDown() override {
+        delete runner;
+    }
+};
+
+TEST_F(ScheduledTaskRunnerTest, canRunAfterDelay) {
+    std::atomic<bool> ran { false };
+    auto const start { std::chrono::steady_clock::now() };
+    std::chrono::steady_clock::time_point ranAt;
+    gb::ScheduledTaskRunner::Handle const handle { runner->schedule(std::chrono::milliseconds(20), [&]{
+        ranAt = std::chrono::steady_clock::now();
+        ran = true;
+        ran.notify_all();
+    }) };
+    ASSERT_TRUE(handle.isValid());
+    ran.wait(false);
+    ASSERT_GE(ranAt - start, std::chrono::milliseconds(20));
+}
+
+TEST_F(ScheduledTaskRunnerTest, runsInDeadlineOrder) {
+    std::mutex orderLock;
+    std::vector<int> order;
+    std::atomic<int> count { 0 };
+    // Spread over several wheel levels.
+    std::vector<int> const delays { 300, 5, 70, 1, 150, 30 };
+    for (int const delay: delays) {
+        runner->schedule(std::chrono::milliseconds(delay), [&, delay]{
+            std::lock_guard<std::mutex> lock { orderLock };
+            order.push_back(delay);
+            ++count;
+            count.notify_all();
+        });
+    }
+    for (int current = count; current < static_cast<int>(delays.size()); current = count) {
+        count.wait(current);
+    }
+    ASSERT_EQ(order, (std::vector<int> { 1, 5, 30, 70, 150, 300 }));
+}
+
+TEST_F(ScheduledTaskRunnerTest, runsLateTimersInDeadlineOrder) {
+    std::mutex orderLock;
+    std::vector<int> order;
+    std::atomic<int> count { 0 };
+    // Holds the thread back, so the next ones are all due by the time it gets to them.
+    std::ignore = runner->schedule(std::chrono::milliseconds(1), []{
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    });
+    for (int const delay: { 30, 10, 20 }) {
+        std::ignore = runner->schedule(std::chrono::milliseconds(delay), [&, delay]{
+            std::lock_guard<std::mutex> lock { orderLock };
+            order.push_back(delay);
+            ++count;
+            count.notify_all();
+        });
+    }
+    for (int current = count; current < 3; current = count) {
+        count.wait(current);
+    }
+    std::lock_guard<std::mutex> lock { orderLock };
+    ASSERT_EQ(order, (std::vector<int> { 10, 20, 30 }));
+}
+
+TEST_F(ScheduledTaskRunnerTest, canCancelInvalidHandle) {
+    gb::ScheduledTaskRunner::Handle const handle;
+    handle.cancel();
+    ASSERT_FALSE(handle.isCanceled());
+}
+
+TEST_F(ScheduledTaskRunnerTest, canCancel) {
+    std::atomic<bool> ran { false };
+    gb::ScheduledTaskRunner::Handle const handle { runner->schedule(std::chrono::milliseconds(20), [&]{ ran = true; }) };
+    handle.cancel();
+    ASSERT_TRUE(handle.isCanceled());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(ran);
+}
+
+TEST_F(ScheduledTaskRunnerTest, releasesActionWhenCanceled) {
+    std::shared_ptr<int> const token { std::make_shared<int>(0) };
+    gb::ScheduledTaskRunner::Handle const handle { runner->schedule(std::chrono::hours(1), [token]{}) };
+    ASSERT_EQ(token.use_count(), 2);
+    handle.cancel();
+    ASSERT_EQ(token.use_count(), 1);
+}
+
+TEST_F(ScheduledTaskRunnerTest, cannotScheduleWithoutPeriod) {
+    ASSERT_FALSE(runner->scheduleAtFixedRate(std::chrono::milliseconds(0), std::chrono::milliseconds(0), []{}).isValid());
+    ASSERT_FALSE(runner->scheduleWithFixedDelay(std::chrono::milliseconds(0), -std::chrono::milliseconds(1), []{}).isValid());
+}
+
+TEST(ScheduledTaskRunnerTickTest, canRunWithoutTick) {
+    gb::ScheduledTaskRunner runner { std::chrono::steady_clock::duration::zero() };
+    std::atomic<bool> ran { false };
+    ASSERT_TRUE(runner.schedule(std::chrono::milliseconds(1), [&]{
+        ran = true;
+        ran.notify_all();
+    }).isValid());
+    ran.wait(false);
+}
+
+TEST_F(ScheduledTaskRunnerTest, canRunAtFixedRate) {
+    std::atomic<int> runs { 0 };
+    gb::ScheduledTaskRunner::Handle const handle {
+        runner->scheduleAtFixedRate(std::chrono::milliseconds(0), std::chrono::milliseconds(5), [&]{
+            ++runs;
+            runs.notify_all();
+        })
+    };
+    for (int current = runs; current < 5; current = runs) {
+        runs.wait(current);
+    }
+    handle.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int const stoppedAt { runs };
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    ASSERT_EQ(runs, stoppedAt);
+}
+
+TEST_F(ScheduledTaskRunnerTest, canRunWithFixedDelay) {
+    std::atomic<int> runs { 0 };
+    gb::ScheduledTaskRunner::Handle const handle {
+        runner->scheduleWithFixedDelay(std::chrono::milliseconds(0), std::chrono::milliseconds(5), [&]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ++runs;
+            runs.notify_all();
+        })
+    };
+    auto const start { std::chrono::steady_clock::now() };
+    for (int current = runs; current < 4; current = runs) {
+        runs.wait(current);
+    }
+    handle.cancel();
+    // Each run takes 5ms, plus 5ms in between.
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(35));
+}
+
+TEST_F(ScheduledTaskRunnerTest, canHoldManyTimers) {
+    std::atomic<int> runs { 0 };
+    for (int i = 0; i < 10000; ++i) {
+        gb::ScheduledTaskRunner::Handle const handle {
+            runner->schedule(std::chrono::milliseconds(20 + i % 50), [&]{
+                ++runs;
+                runs.notify_all();
+            })
+        };
+        if (i % 2 == 0) {
+            handle.cancel();
+        }
+    }
+    for (int current = runs; current < 5000; current = runs) {
+        runs.wait(current);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    ASSERT_EQ(runs, 5000);
+}
+
+TEST_F(ScheduledTaskRunnerTest, cannotScheduleAfterShutdown) {
+    runner->shutdown();
+    ASSERT_FALSE(runner->isActive());
+    ASSERT_FALSE(runner->schedule(std::chrono::milliseconds(0), []{}).isValid());
+}
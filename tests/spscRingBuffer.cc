@@ -0,0 +1,67 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+TEST(SpscRingBuffer, canTryPushAndPop) {
+    gb::SpscRingBuffer<std::string> buffer { 2 };
+    ASSERT_EQ(buffer.capacity(), 2);
+    ASSERT_TRUE(buffer.tryPush("one"));
+    ASSERT_TRUE(buffer.tryPush("two"));
+    std::string three { "three" };
+    ASSERT_FALSE(buffer.tryPush(std::move(three)));
+    ASSERT_EQ(three, "three");
+    ASSERT_EQ(buffer.size(), 2);
+    ASSERT_EQ(buffer.tryPop(), "one");
+    ASSERT_TRUE(buffer.tryPush(std::move(three)));
+    ASSERT_EQ(buffer.tryPop(), "two");
+    ASSERT_EQ(buffer.tryPop(), "three");
+    ASSERT_FALSE(buffer.tryPop());
+}
+
+TEST(SpscRingBuffer, canPushAndPopBatches) {
+    gb::SpscRingBuffer<int> buffer { 8 };
+    std::vector<int> values { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    ASSERT_EQ(buffer.tryPushBatch(values), 8);
+    std::vector<int> popped(5);
+    ASSERT_EQ(buffer.tryPopBatch(popped), 5);
+    ASSERT_EQ(popped, (std::vector<int> { 1, 2, 3, 4, 5 }));
+    ASSERT_EQ(buffer.tryPushBatch(std::span { values }.subspan(8)), 2);
+    ASSERT_EQ(buffer.tryPopBatch(popped), 5);
+    ASSERT_EQ(popped, (std::vector<int> { 6, 7, 8, 9, 10 }));
+    ASSERT_EQ(buffer.tryPopBatch(popped), 0);
+}
+
+TEST(SpscRingBuffer, canPassValuesBetweenThreads) {
+    gb::SpscRingBuffer<uint64_t> buffer { 1024 };
+    constexpr uint64_t count { 200000 };
+    std::thread producer { [&]{
+        uint64_t next { 1 };
+        std::array<uint64_t, 32> batch {};
+        while (next <= count) {
+            size_t const size { static_cast<size_t>(std::min<uint64_t>(batch.size(), count - next + 1)) };
+            for (size_t i = 0; i < size; ++i) {
+                batch[i] = next + i;
+            }
+            size_t pushed { 0 };
+            while (pushed < size) {
+                pushed += buffer.tryPushBatch(std::span { batch }.subspan(pushed, size - pushed));
+            }
+            next += size;
+        }
+    } };
+    uint64_t expected { 1 };
+    bool inOrder { true };
+    std::array<uint64_t, 64> batch {};
+    while (expected <= count) {
+        size_t const popped { buffer.tryPopBatch(batch) };
+        for (size_t i = 0; i < popped; ++i) {
+            inOrder = inOrder && (batch[i] == expected);
+            ++expected;
+        }
+    }
+    producer.join();
+    ASSERT_TRUE(inOrder);
+    ASSERT_EQ(buffer.size(), 0);
+}
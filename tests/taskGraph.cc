@@ -0,0 +1,186 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+class StepLog {
+public:
+    std::mutex lock;
+    std::vector<std::string> steps;
+
+    void add(std::string const& step) noexcept {
+        std::lock_guard<std::mutex> guard { lock };
+        steps.push_back(step);
+    }
+
+    [[nodiscard]]
+    size_t indexOf(std::string const& step) noexcept {
+        std::lock_guard<std::mutex> guard { lock };
+        return static_cast<size_t>(std::ranges::find(steps, step) - steps.begin());
+    }
+};
+
+class StepTask : public gb::Task {
+private:
+    StepLog& log;
+    std::string const name;
+    std::chrono::milliseconds const duration;
+
+public:
+    std::atomic<gb::Task::Priority> ranWith { gb::Task::Priority::Low };
+
+    StepTask(StepLog& log, std::string name, std::chrono::milliseconds const duration = std::chrono::milliseconds(0)) noexcept :
+        log(log), name(std::move(name)), duration(duration) {}
+
+protected:
+    void action() noexcept override {
+        started();
+        ranWith = getPriority();
+        std::this_thread::sleep_for(duration);
+        if (!shouldCancel()) {
+            log.add(name);
+        }
+    }
+};
+
+class TaskGraphTest : public ::testing::Test {
+protected:
+    gb::TaskRunner* runner { nullptr };
+    StepLog log;
+
+    void SetUp() override {
+        runner = new gb::TaskRunner(4);
+    }
+
+    void TearDown() override {
+        delete runner;
+    }
+
+    std::shared_ptr<StepTask> step(std::string const& name, int const ms = 0) noexcept {
+        return std::make_shared<StepTask>(log, name, std::chrono::milliseconds(ms));
+    }
+};
+
+TEST_F(TaskGraphTest, runsDependenciesFirst) {
+    gb::TaskGraph graph;
+    size_t const extract { graph.add(step("extract", 5)) };
+    size_t const cleanA { graph.add(step("cleanA", 5), { extract }) };
+    size_t const cleanB { graph.add(step("cleanB"), { extract }) };
+    graph.add(step("load"), { cleanA, cleanB });
+    ASSERT_TRUE(graph.start(*runner));
+    graph.awaitStop();
+    ASSERT_TRUE(graph.isStopped());
+    ASSERT_EQ(log.steps.size(), 4);
+    ASSERT_EQ(log.indexOf("extract"), 0);
+    ASSERT_EQ(log.indexOf("load"), 3);
+}
+
+TEST_F(TaskGraphTest, runsIndependentNodesConcurrently) {
+    gb::TaskGraph graph;
+    size_t const source { graph.add(step("source")) };
+    for (int i = 0; i < 4; ++i) {
+        graph.add(step(std::to_string(i), 50), { source });
+    }
+    auto const start { std::chrono::steady_clock::now() };
+    graph.start(*runner);
+    graph.awaitStop();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+    ASSERT_EQ(log.steps.size(), 5);
+}
+
+TEST_F(TaskGraphTest, raisesCriticalPathPriorityWhileRunning) {
+    gb::TaskGraph graph;
+    std::vector<std::shared_ptr<StepTask>> const tasks { step("a"), step("b"), step("c"), step("side"), step("user") };
+    tasks[4]->setPriority(gb::Task::Priority::High);
+    size_t const a { graph.add(tasks[0]) };
+    size_t const b { graph.add(tasks[1], { a }) };
+    graph.add(tasks[2], { b });
+    graph.add(tasks[3], { a });
+    graph.add(tasks[4], { b });
+    graph.start(*runner);
+    graph.awaitStop();
+    ASSERT_EQ(tasks[0]->ranWith, gb::Task::Priority::High);
+    ASSERT_EQ(tasks[1]->ranWith, gb::Task::Priority::High);
+    ASSERT_EQ(tasks[2]->ranWith, gb::Task::Priority::High);
+    ASSERT_EQ(tasks[3]->ranWith, gb::Task::Priority::Normal);
+    // Raised priorities are restored, and the user's are kept.
+    for (size_t i = 0; i < 4; ++i) {
+        ASSERT_EQ(tasks[i]->getPriority(), gb::Task::Priority::Normal);
+    }
+    ASSERT_EQ(tasks[4]->getPriority(), gb::Task::Priority::High);
+}
+
+TEST_F(TaskGraphTest, canCancelSubgraph) {
+    gb::TaskGraph graph;
+    size_t const root { graph.add(step("root", 20)) };
+    size_t const keep { graph.add(step("keep"), { root }) };
+    size_t const drop { graph.add(step("drop"), { root }) };
+    graph.add(step("dropChild"), { drop });
+    graph.add(step("join"), { keep, drop });
+    graph.start(*runner);
+    graph.cancel(drop);
+    graph.awaitStop();
+    ASSERT_EQ(log.steps, (std::vector<std::string> { "root", "keep" }));
+}
+
+class GateTask : public gb::Task {
+public:
+    std::atomic<bool> gate { false };
+
+    void open() noexcept {
+        gate = true;
+        gate.notify_all();
+    }
+
+protected:
+    void action() noexcept override {
+        started();
+        gate.wait(false);
+    }
+};
+
+TEST_F(TaskGraphTest, skipsDependentsOfTasksThatFailToStart) {
+    gb::TaskRunner bounded {
+        gb::TaskRunner::ThreadOptions { .maxThreads = 2, .overflowPolicy = gb::TaskRunner::OverflowPolicy::Reject }
+    };
+    std::shared_ptr<GateTask> const rootTask { std::make_shared<GateTask>() };
+    std::shared_ptr<GateTask> const gateTask { std::make_shared<GateTask>() };
+    gb::TaskGraph graph;
+    size_t const root { graph.add(rootTask) };
+    size_t const gated { graph.add(gateTask) };
+    size_t const rejected { graph.add(step("rejected"), { root }) };
+    graph.add(step("dependent"), { rejected, gated });
+    graph.start(bounded);
+    // Both roots hold a slot, and root still holds its own when it starts its dependent, so
+    // that one is rejected.
+    rootTask->awaitStart();
+    gateTask->awaitStart();
+    rootTask->open();
+    while (bounded.getAdmissionStats().rejected == 0) {
+        std::this_thread::yield();
+    }
+    gateTask->open();
+    graph.awaitStop();
+    ASSERT_TRUE(log.steps.empty());
+}
+
+TEST_F(TaskGraphTest, canRunLongChain) {
+    gb::TaskGraph graph;
+    size_t previous { graph.add(step("0")) };
+    for (int i = 1; i < 200; ++i) {
+        previous = graph.add(step(std::to_string(i)), { previous });
+    }
+    graph.start(*runner);
+    graph.awaitStop();
+    ASSERT_EQ(log.steps.size(), 200);
+    ASSERT_EQ(log.steps.back(), "199");
+}
+
+TEST_F(TaskGraphTest, cannotStartTwice) {
+    gb::TaskGraph graph;
+    graph.add(step("only"));
+    ASSERT_TRUE(graph.start(*runner));
+    ASSERT_FALSE(graph.start(*runner));
+    graph.awaitStop();
+}
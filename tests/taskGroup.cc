@@ -0,0 +1,175 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+
+class UntilCanceledTask : public gb::Task {
+public:
+    std::atomic<bool> sawCancel { false };
+
+protected:
+    void action() noexcept override {
+        started();
+        while (!shouldCancel()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        sawCancel = true;
+    }
+};
+
+class FunctionTask : public gb::Task {
+private:
+    std::function<void()> const fn;
+
+public:
+    explicit FunctionTask(std::function<void()> fn) noexcept : fn(std::move(fn)) {}
+
+protected:
+    void action() noexcept override {
+        started();
+        fn();
+    }
+};
+
+TEST(TaskGroup, awaitsChildrenOnScopeExit) {
+    gb::TaskRunner runner { 1 };
+    std::atomic<int> count { 0 };
+    std::shared_ptr<FunctionTask> const parent { std::make_shared<FunctionTask>([&]{
+        gb::TaskGroup group;
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_TRUE(group.submit([&]{ ++count; }).isValid());
+        }
+    }) };
+    runner.start(parent);
+    parent->awaitStop();
+    ASSERT_EQ(count, 10);
+}
+
+TEST(TaskGroup, canReturnResultsFromChildren) {
+    gb::TaskRunner runner { 2 };
+    gb::TaskGroup group { runner };
+    gb::Future<int> const a { group.submit([]{ return 20; }) };
+    gb::Future<int> const b { group.submit([]{ return 22; }) };
+    group.wait();
+    ASSERT_EQ(a.get() + b.get(), 42);
+}
+
+TEST(TaskGroup, parentCancelReachesChildren) {
+    gb::TaskRunner runner { 4 };
+    std::vector<std::shared_ptr<UntilCanceledTask>> children;
+    for (int i = 0; i < 3; ++i) {
+        children.push_back(std::make_shared<UntilCanceledTask>());
+    }
+    std::shared_ptr<FunctionTask> const parent { std::make_shared<FunctionTask>([&]{
+        gb::TaskGroup group;
+        for (auto const& child: children) {
+            group.start(child);
+        }
+    }) };
+    runner.start(parent);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    parent->cancel();
+    parent->awaitStop();
+    for (auto const& child: children) {
+        ASSERT_TRUE(child->sawCancel);
+    }
+}
+
+TEST(TaskGroup, cancelOnlyReachesItsOwnChildren) {
+    gb::TaskRunner runner { 4 };
+    gb::TaskGroup canceled { runner };
+    gb::TaskGroup kept { runner };
+    std::shared_ptr<UntilCanceledTask> const a { std::make_shared<UntilCanceledTask>() };
+    std::shared_ptr<UntilCanceledTask> const b { std::make_shared<UntilCanceledTask>() };
+    canceled.start(a);
+    kept.start(b);
+    canceled.cancel();
+    canceled.wait();
+    ASSERT_TRUE(a->sawCancel);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(b->isStopped());
+    b->cancel();
+}
+
+TEST(TaskGroup, cancelReachesNestedGroups) {
+    gb::TaskRunner runner { 4 };
+    std::shared_ptr<UntilCanceledTask> const grandchild { std::make_shared<UntilCanceledTask>() };
+    gb::TaskGroup group { runner };
+    group.start(std::make_shared<FunctionTask>([&]{
+        gb::TaskGroup inner;
+        inner.start(grandchild);
+    }));
+    grandchild->awaitStart();
+    group.cancel();
+    group.wait();
+    ASSERT_TRUE(grandchild->sawCancel);
+}
+
+TEST(TaskGroup, cannotStartOutsideOfTask) {
+    gb::TaskGroup group;
+    ASSERT_FALSE(group.submit([]{}).isValid());
+}
+
+class BlockedUntilStopTask : public gb::Task {
+protected:
+    void action() noexcept override {
+        started();
+        std::mutex lock;
+        std::unique_lock<std::mutex> waitLock { lock };
+        std::condition_variable_any {}.wait(waitLock, getStopToken(), []{ return false; });
+    }
+};
+
+TEST(TaskGroup, ownerCancelReachesStopTokens) {
+    gb::TaskRunner runner { 4 };
+    std::shared_ptr<BlockedUntilStopTask> const child { std::make_shared<BlockedUntilStopTask>() };
+    std::shared_ptr<FunctionTask> const parent { std::make_shared<FunctionTask>([&]{
+        gb::TaskGroup group;
+        group.start(child);
+    }) };
+    runner.start(parent);
+    child->awaitStart();
+    parent->cancel();
+    parent->awaitStop();
+    ASSERT_TRUE(child->isStopped());
+}
+
+// The token is linked to the group's even if it was taken before the task was started.
+TEST(TaskGroup, cancelReachesStopTokensTakenBeforeStart) {
+    gb::TaskRunner runner { 2 };
+    std::shared_ptr<BlockedUntilStopTask> const child { std::make_shared<BlockedUntilStopTask>() };
+    std::stop_token const token { child->getStopToken() };
+    gb::TaskGroup group { runner };
+    group.start(child);
+    child->awaitStart();
+    group.cancel();
+    group.wait();
+    ASSERT_TRUE(token.stop_requested());
+    ASSERT_TRUE(child->isStopped());
+}
+
+class StartsAfterGateTask : public gb::Task {
+public:
+    std::atomic<bool> gate { false };
+
+protected:
+    void action() noexcept override {
+        gate.wait(false);
+        started();
+    }
+};
+
+TEST(TaskGroup, cannotStartTaskAlreadyRunning) {
+    gb::TaskRunner runner { 2 };
+    // Running, but not yet signaled it started.
+    std::shared_ptr<StartsAfterGateTask> const task { std::make_shared<StartsAfterGateTask>() };
+    ASSERT_TRUE(runner.startAsync(task));
+    {
+        gb::TaskGroup group { runner };
+        ASSERT_FALSE(group.start(task));
+    }
+    task->gate = true;
+    task->gate.notify_all();
+    task->awaitStop();
+}
@@ -3,6 +3,9 @@
 
 #include <glitchybyte/gb/gb.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
+
+void clearCancelableItems() noexcept;
 
 class TaskRunnerTest : public ::testing::Test {
 protected:
@@ -10,6 +13,7 @@ protected:
 
 protected:
     void SetUp() override {
+        clearCancelableItems();
         runner = new gb::TaskRunner();
     }
 
@@ -64,7 +68,19 @@ TEST_F(TaskRunnerTest, canCancelTask) {
     ASSERT_FALSE(task->items.contains("one"));
 }
 
-class CancelableTask : public gb::Task {
+// Blocks until canceled, no polling.
+class StopWaitingTask : public gb::Task {
+protected:
+    void action() noexcept override {
+        started();
+        std::mutex lock;
+        std::unique_lock<std::mutex> waitLock { lock };
+        std::condition_variable_any {}.wait(waitLock, getStopToken(), []{ return false; });
+    }
+};
+
+// Records an item once canceled, in a set shared by all, so other tests use StopWaitingTask.
+class CancelableTask : public StopWaitingTask {
 public:
     static std::set<std::string> items;
     static std::mutex itemsLock;
@@ -83,10 +99,7 @@ public:
 
 protected:
     void action() noexcept override {
-        started();
-        while (!shouldCancel()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+        StopWaitingTask::action();
         addItem(itemToAdd);
     }
 };
@@ -94,6 +107,11 @@ protected:
 std::set<std::string> CancelableTask::items;
 std::mutex CancelableTask::itemsLock;
 
+void clearCancelableItems() noexcept {
+    std::lock_guard<std::mutex> lock { CancelableTask::itemsLock };
+    CancelableTask::items.clear();
+}
+
 TEST_F(TaskRunnerTest, canCancelAllTasks) {
     std::shared_ptr<CancelableTask> task1 = std::make_shared<CancelableTask>("one");
     std::shared_ptr<CancelableTask> task2 = std::make_shared<CancelableTask>("two");
@@ -108,3 +126,835 @@ TEST_F(TaskRunnerTest, canCancelAllTasks) {
     ASSERT_TRUE(CancelableTask::items.contains("two"));
     ASSERT_TRUE(CancelableTask::items.contains("three"));
 }
+
+// Starts tasks from a stop callback, so some land in its own registry shard while it's canceled.
+class SpawningOnCancelTask : public gb::Task {
+protected:
+    void action() noexcept override {
+        started();
+        std::stop_callback const onCancel { getStopToken(), [this]{
+            for (int i = 0; i < 64; ++i) {
+                getTaskRunner()->startAsync(std::make_shared<SimpleTask>());
+            }
+        } };
+        std::mutex lock;
+        std::unique_lock<std::mutex> waitLock { lock };
+        std::condition_variable_any {}.wait(waitLock, getStopToken(), []{ return false; });
+    }
+};
+
+TEST_F(TaskRunnerTest, canStartTasksFromStopCallbacks) {
+    std::shared_ptr<SpawningOnCancelTask> const task { std::make_shared<SpawningOnCancelTask>() };
+    runner->start(task);
+    runner->cancelAll();
+    runner->awaitAll();
+    ASSERT_TRUE(task->isStopped());
+}
+
+class PooledTaskRunnerTest : public ::testing::Test {
+protected:
+    gb::TaskRunner* runner { nullptr };
+
+protected:
+    void SetUp() override {
+        runner = new gb::TaskRunner(2);
+    }
+
+    void TearDown() override {
+        delete runner;
+    }
+};
+
+TEST_F(PooledTaskRunnerTest, canStartTask) {
+    std::shared_ptr<SimpleTask> task = std::make_shared<SimpleTask>();
+    ASSERT_TRUE(runner->isPooled());
+    ASSERT_EQ(runner->getWorkerCount(), 2);
+    runner->start(task);
+    task->awaitStop();
+    ASSERT_TRUE(task->items.contains("one"));
+}
+
+TEST_F(PooledTaskRunnerTest, canCancelTask) {
+    std::shared_ptr<SlowTask> task = std::make_shared<SlowTask>();
+    runner->start(task);
+    task->cancel();
+    task->awaitStop();
+    ASSERT_FALSE(task->items.contains("one"));
+}
+
+TEST_F(PooledTaskRunnerTest, canReuseWorkers) {
+    std::vector<std::shared_ptr<SimpleTask>> tasks;
+    for (int i = 0; i < 100; ++i) {
+        std::shared_ptr<SimpleTask> task = std::make_shared<SimpleTask>();
+        tasks.push_back(task);
+        ASSERT_TRUE(runner->start(task));
+    }
+    runner->awaitAll();
+    for (auto const& task: tasks) {
+        ASSERT_TRUE(task->items.contains("one"));
+    }
+}
+
+class FanOutTask : public gb::Task {
+public:
+    static std::atomic<int> count;
+
+private:
+    int const depth;
+
+public:
+    explicit FanOutTask(int const depth) noexcept : depth(depth) {};
+
+protected:
+    void action() noexcept override {
+        started();
+        ++count;
+        if (depth == 0) {
+            return;
+        }
+        for (int i = 0; i < 4; ++i) {
+            getTaskRunner()->start(std::make_shared<FanOutTask>(depth - 1));
+        }
+    }
+};
+
+std::atomic<int> FanOutTask::count { 0 };
+
+TEST(WorkStealingTaskRunnerTest, canFanOutFromTasks) {
+    gb::TaskRunner runner { gb::TaskRunner::Options { .workerCount = 3, .workStealing = true } };
+    FanOutTask::count = 0;
+    runner.start(std::make_shared<FanOutTask>(4));
+    runner.awaitAll();
+    // 1 + 4 + 16 + 64 + 256
+    ASSERT_EQ(FanOutTask::count, 341);
+}
+
+// Parents hand their child to their own queue, which wakes idle workers that may find it taken.
+TEST(WorkStealingTaskRunnerTest, keepsWorkersAfterLocalTasksAreTaken) {
+    size_t const workerCount { 2 };
+    gb::TaskRunner runner { gb::TaskRunner::Options { .workerCount = workerCount, .workStealing = true } };
+    // One parent at a time, so the other worker is idle and gets woken for each child.
+    for (int i = 0; i < 500; ++i) {
+        runner.submit([&runner]{ runner.start(std::make_shared<SimpleTask>()); }).wait();
+    }
+    // Every worker must still be there to run one of these at the same time.
+    std::atomic<size_t> running { 0 };
+    std::atomic<bool> gate { false };
+    for (size_t i = 0; i < workerCount; ++i) {
+        std::ignore = runner.submit([&]{
+            ++running;
+            gate.wait(false);
+        });
+    }
+    std::chrono::steady_clock::time_point const deadline { std::chrono::steady_clock::now() + std::chrono::seconds(5) };
+    while ((running < workerCount) && (std::chrono::steady_clock::now() < deadline)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    size_t const concurrent { running };
+    gate = true;
+    gate.notify_all();
+    runner.awaitAll();
+    ASSERT_EQ(concurrent, workerCount);
+}
+
+// Waits for its gate to open, before or after signaling it started.
+class GatedTask : public SimpleTask {
+public:
+    std::atomic<bool> gate { false };
+
+private:
+    bool const waitsBeforeStart;
+
+public:
+    explicit GatedTask(bool const waitsBeforeStart = true) noexcept : waitsBeforeStart(waitsBeforeStart) {}
+
+    void open() noexcept {
+        gate = true;
+        gate.notify_all();
+    }
+
+protected:
+    void action() noexcept override {
+        if (waitsBeforeStart) {
+            gate.wait(false);
+        }
+        started();
+        if (!waitsBeforeStart) {
+            gate.wait(false);
+        }
+        addItem("one");
+    }
+};
+
+// start could run the child on the parent's worker, where it would wait on its parent forever.
+TEST(WorkStealingTaskRunnerTest, canStartTasksThatWaitForTheirParent) {
+    gb::TaskRunner runner { gb::TaskRunner::Options { .workerCount = 2, .workStealing = true } };
+    std::shared_ptr<GatedTask> const child { std::make_shared<GatedTask>(false) };
+    runner.submit([&runner, &child]{
+        runner.startAsync(child);
+        child->awaitStart();
+        child->open();
+    }).wait();
+    runner.awaitAll();
+    ASSERT_TRUE(child->isStopped());
+}
+
+class CountingTask : public gb::Task {
+public:
+    std::atomic<int> runCount { 0 };
+
+protected:
+    void action() noexcept override {
+        started();
+        ++runCount;
+    }
+};
+
+// Tasks are placed once, even if their priority changes while they are queued.
+TEST(WorkStealingTaskRunnerTest, runsTasksOnceWhileTheirPriorityChanges) {
+    gb::TaskRunner runner { gb::TaskRunner::Options { .workerCount = 2, .workStealing = true } };
+    std::vector<std::shared_ptr<gb::Task>> tasks;
+    for (int i = 0; i < 2000; ++i) {
+        tasks.push_back(std::make_shared<CountingTask>());
+    }
+    std::atomic<bool> done { false };
+    std::atomic<int> rounds { 0 };
+    std::thread changer {
+        [&]{
+            while (!done) {
+                for (auto const& task: tasks) {
+                    bool const isNormal { task->getPriority() == gb::Task::Priority::Normal };
+                    task->setPriority(isNormal ? gb::Task::Priority::High : gb::Task::Priority::Normal);
+                }
+                ++rounds;
+            }
+        }
+    };
+    while (rounds == 0) {
+        std::this_thread::yield();
+    }
+    // A batch is placed by a worker in two passes, so changes have time to land in between.
+    runner.submit([&runner, &tasks]{ runner.startAll(tasks); }).wait();
+    runner.awaitAll();
+    done = true;
+    changer.join();
+    for (auto const& task: tasks) {
+        ASSERT_EQ(static_cast<CountingTask&>(*task).runCount, 1);
+    }
+}
+
+TEST_F(TaskRunnerTest, canStartTaskAsync) {
+    std::shared_ptr<GatedTask> task = std::make_shared<GatedTask>();
+    ASSERT_TRUE(runner->startAsync(task));
+    ASSERT_EQ(task->getState(), gb::Task::State::Created);
+    task->open();
+    task->awaitStart();
+    task->awaitStop();
+    ASSERT_TRUE(task->items.contains("one"));
+}
+
+TEST_F(PooledTaskRunnerTest, canStartTaskAsync) {
+    std::shared_ptr<GatedTask> task = std::make_shared<GatedTask>();
+    ASSERT_TRUE(runner->startAsync(task));
+    ASSERT_EQ(task->getState(), gb::Task::State::Created);
+    task->open();
+    task->awaitStart();
+    task->awaitStop();
+    ASSERT_TRUE(task->items.contains("one"));
+}
+
+TEST_F(TaskRunnerTest, cannotStartRunningTaskTwice) {
+    std::shared_ptr<GatedTask> task = std::make_shared<GatedTask>();
+    ASSERT_TRUE(runner->startAsync(task));
+    ASSERT_FALSE(runner->startAsync(task));
+    task->open();
+    runner->awaitAll();
+    ASSERT_TRUE(task->items.contains("one"));
+}
+
+TEST_F(TaskRunnerTest, canStartAllTasks) {
+    std::vector<std::shared_ptr<gb::Task>> tasks;
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back(std::make_shared<SimpleTask>());
+    }
+    ASSERT_EQ(runner->startAll(tasks), 10);
+    runner->awaitAll();
+    for (auto const& task: tasks) {
+        ASSERT_TRUE(std::static_pointer_cast<SimpleTask>(task)->items.contains("one"));
+    }
+}
+
+TEST_F(PooledTaskRunnerTest, canStartAllTasks) {
+    std::vector<std::shared_ptr<gb::Task>> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.push_back(std::make_shared<SimpleTask>());
+    }
+    ASSERT_EQ(runner->startAll(tasks), 100);
+    runner->awaitAll();
+    for (auto const& task: tasks) {
+        ASSERT_TRUE(std::static_pointer_cast<SimpleTask>(task)->items.contains("one"));
+    }
+}
+
+// For pools of a single worker, which it can keep busy so the next tasks queue up.
+class BlockedWorkerTest : public ::testing::Test {
+protected:
+    std::atomic<bool> blocked { false };
+    std::atomic<bool> gate { false };
+
+    void blockWorker(gb::TaskRunner& runner) noexcept {
+        std::ignore = runner.submit([this]{
+            blocked = true;
+            blocked.notify_all();
+            gate.wait(false);
+        });
+        blocked.wait(false);
+    }
+
+    void unblockWorker() noexcept {
+        gate = true;
+        gate.notify_all();
+    }
+};
+
+class PriorityTaskRunnerTest : public BlockedWorkerTest {
+protected:
+    std::mutex orderLock;
+    std::vector<std::string> order;
+
+    auto record(std::string const& name) noexcept {
+        return [this, name]{
+            std::lock_guard<std::mutex> lock { orderLock };
+            order.push_back(name);
+        };
+    }
+};
+
+TEST_F(PriorityTaskRunnerTest, runsHigherPriorityFirst) {
+    gb::TaskRunner runner { gb::TaskRunner::Options { .workerCount = 1, .priorityAging = std::chrono::milliseconds(0) } };
+    blockWorker(runner);
+    std::ignore = runner.submit(record("low"), gb::Task::Priority::Low);
+    std::ignore = runner.submit(record("normal"));
+    std::ignore = runner.submit(record("high"), gb::Task::Priority::High);
+    unblockWorker();
+    runner.awaitAll();
+    ASSERT_EQ(order, (std::vector<std::string> { "high", "normal", "low" }));
+}
+
+TEST_F(PriorityTaskRunnerTest, agesLowPriorityTasks) {
+    std::chrono::milliseconds const aging { 10 };
+    gb::TaskRunner runner { gb::TaskRunner::Options { .workerCount = 1, .priorityAging = aging } };
+    blockWorker(runner);
+    std::ignore = runner.submit(record("low"), gb::Task::Priority::Low);
+    // Both age from when they are queued, so low is ahead once queued 3 intervals before high,
+    // however late the worker gets to them.
+    std::this_thread::sleep_until(std::chrono::steady_clock::now() + aging * 3);
+    std::ignore = runner.submit(record("high"), gb::Task::Priority::High);
+    unblockWorker();
+    runner.awaitAll();
+    ASSERT_EQ(order, (std::vector<std::string> { "low", "high" }));
+}
+
+TEST_F(PriorityTaskRunnerTest, agesLowPriorityTasksPastLocalTasks) {
+    gb::TaskRunner runner {
+        gb::TaskRunner::Options { .workerCount = 1, .workStealing = true, .priorityAging = std::chrono::milliseconds(10) }
+    };
+    std::atomic<bool> lowRan { false };
+    std::atomic<bool> gaveUp { false };
+    // Bounded, so it fails instead of hanging if low starves.
+    std::chrono::steady_clock::time_point const deadline { std::chrono::steady_clock::now() + std::chrono::seconds(10) };
+    std::function<void()> respawn;
+    respawn = [&]{
+        if (lowRan) {
+            return;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            gaveUp = true;
+            return;
+        }
+        // Normal children of a running task go to the worker's local queue.
+        std::ignore = runner.submit(respawn);
+    };
+    blockWorker(runner);
+    std::ignore = runner.submit([&]{ lowRan = true; }, gb::Task::Priority::Low);
+    std::ignore = runner.submit(respawn);
+    unblockWorker();
+    runner.awaitAll();
+    ASSERT_TRUE(lowRan);
+    ASSERT_FALSE(gaveUp);
+}
+
+TEST_F(PooledTaskRunnerTest, canRecordMetrics) {
+    runner->enableMetrics();
+    std::shared_ptr<SlowTask> const slow { std::make_shared<SlowTask>() };
+    runner->start(slow);
+    slow->awaitStop();
+    std::shared_ptr<StopWaitingTask> const cancelable { std::make_shared<StopWaitingTask>() };
+    runner->start(cancelable);
+    cancelable->cancel();
+    cancelable->awaitStop();
+    ASSERT_GT(slow->getMetrics().runTime, std::chrono::milliseconds(0));
+    ASSERT_GT(cancelable->getMetrics().cancelLatency, std::chrono::nanoseconds(0));
+    gb::TaskRunner::Metrics const metrics { runner->getMetrics() };
+    ASSERT_EQ(metrics.queueLatency.count, 2);
+    ASSERT_EQ(metrics.runTime.count, 2);
+    ASSERT_EQ(metrics.startLatency.count, 2);
+    ASSERT_EQ(metrics.cancelLatency.count, 1);
+}
+
+TEST_F(TaskRunnerTest, hasNoMetricsUnlessEnabled) {
+    std::shared_ptr<SimpleTask> const task { std::make_shared<SimpleTask>() };
+    runner->start(task);
+    task->awaitStop();
+    ASSERT_EQ(task->getMetrics().runTime, std::chrono::nanoseconds(0));
+    ASSERT_EQ(runner->getMetrics().runTime.count, 0);
+}
+
+TEST_F(PooledTaskRunnerTest, canTraceTasks) {
+    runner->enableTracing();
+    std::shared_ptr<SimpleTask> const first { std::make_shared<SimpleTask>() };
+    std::shared_ptr<SimpleTask> const second { std::make_shared<SimpleTask>() };
+    runner->start(first);
+    runner->start(second);
+    first->awaitStop();
+    second->awaitStop();
+    std::ostringstream out;
+    runner->writeTrace(out);
+    std::string const trace { out.str() };
+    ASSERT_NE(trace.find("\"ph\":\"B\""), std::string::npos);
+    ASSERT_NE(trace.find("\"args\":{\"id\":1}"), std::string::npos);
+    ASSERT_NE(trace.find("\"args\":{\"id\":2}"), std::string::npos);
+}
+
+TEST(ElasticTaskRunnerTest, growsAndShrinksWithDemand) {
+    gb::TaskRunner runner {
+        gb::TaskRunner::Options {
+            .workerCount = 1,
+            .maxWorkerCount = 4,
+            .idleTimeout = std::chrono::milliseconds(10),
+            .blockedWorkerTimeout = std::chrono::milliseconds(0)
+        }
+    };
+    ASSERT_EQ(runner.getWorkerCount(), 1);
+    std::atomic<bool> gate { false };
+    // Tasks are held until all are queued, so the queue outgrows the workers.
+    for (int i = 0; i < 8; ++i) {
+        std::ignore = runner.submit([&gate]{ gate.wait(false); });
+    }
+    size_t const peakCount { runner.getWorkerCount() };
+    gate = true;
+    gate.notify_all();
+    runner.awaitAll();
+    ASSERT_GT(peakCount, 1);
+    ASSERT_LE(peakCount, 4);
+    // Idle workers retire one idle timeout after running out of tasks.
+    std::chrono::steady_clock::time_point const deadline { std::chrono::steady_clock::now() + std::chrono::seconds(10) };
+    while ((runner.getWorkerCount() > 1) && (std::chrono::steady_clock::now() < deadline)) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(runner.getWorkerCount(), 1);
+}
+
+TEST(ElasticTaskRunnerTest, compensatesBlockedWorkers) {
+    gb::TaskRunner runner {
+        gb::TaskRunner::Options {
+            .workerCount = 1,
+            .maxWorkerCount = 2,
+            .blockedWorkerTimeout = std::chrono::milliseconds(20)
+        }
+    };
+    std::atomic<bool> blocked { false };
+    std::atomic<bool> gate { false };
+    // The only worker blocks on a task that only the next one can release.
+    std::ignore = runner.submit([&blocked, &gate]{
+        blocked = true;
+        blocked.notify_all();
+        gate.wait(false);
+    });
+    blocked.wait(false);
+    // Queued while its worker is busy, so the queue is no deeper than the workers, and only
+    // making up for the blocked worker runs it.
+    std::ignore = runner.submit([&gate]{
+        gate = true;
+        gate.notify_all();
+    });
+    runner.awaitAll();
+    ASSERT_EQ(runner.getWorkerCount(), 2);
+}
+
+class NodeTask : public gb::Task {
+public:
+    std::atomic<size_t> ranOn { gb::Task::anyNode };
+
+protected:
+    void action() noexcept override {
+        started();
+        ranOn = getTaskRunner()->getCurrentNode();
+    }
+};
+
+// Records its node before waiting on its gate.
+class GatedNodeTask : public GatedTask {
+public:
+    std::atomic<size_t> ranOn { gb::Task::anyNode };
+
+    GatedNodeTask() noexcept : GatedTask(false) {}
+
+protected:
+    void action() noexcept override {
+        ranOn = getTaskRunner()->getCurrentNode();
+        GatedTask::action();
+    }
+};
+
+TEST(NodeTaskRunnerTest, runsTasksOnTheirNode) {
+    gb::CpuTopology const detected { gb::CpuTopology::detect() };
+    // Two nodes sharing the same CPUs, so it works on any machine.
+    gb::CpuTopology const topology { { detected.getCpus(0), detected.getCpus(0) } };
+    gb::TaskRunner runner {
+        gb::TaskRunner::Options {
+            .workerCount = 4,
+            .workerAffinity = gb::TaskRunner::WorkerAffinity::Node,
+            .topology = &topology
+        }
+    };
+    ASSERT_EQ(runner.getNodeCount(), 2);
+    ASSERT_EQ(runner.getCurrentNode(), gb::Task::anyNode);
+    for (size_t i = 0; i < 20; ++i) {
+        std::shared_ptr<NodeTask> const task { std::make_shared<NodeTask>() };
+        task->setNodeAffinity(i % 2);
+        runner.start(task);
+        task->awaitStop();
+        ASSERT_EQ(task->ranOn, i % 2);
+    }
+}
+
+TEST(NodeTaskRunnerTest, keepsNodeIdsOfNodesWithoutCpus) {
+    gb::CpuTopology const detected { gb::CpuTopology::detect() };
+    // Node 0 has no CPUs, like a memory only node, so all workers are placed on node 1.
+    gb::CpuTopology const topology { { {}, detected.getCpus(0) } };
+    gb::TaskRunner runner {
+        gb::TaskRunner::Options {
+            .workerCount = 2,
+            .workerAffinity = gb::TaskRunner::WorkerAffinity::Node,
+            .topology = &topology
+        }
+    };
+    ASSERT_EQ(runner.getNodeCount(), 2);
+    for (size_t node = 0; node < 2; ++node) {
+        std::shared_ptr<NodeTask> const task { std::make_shared<NodeTask>() };
+        task->setNodeAffinity(node);
+        runner.start(task);
+        task->awaitStop();
+        ASSERT_EQ(task->ranOn, 1);
+    }
+}
+
+TEST(NodeTaskRunnerTest, otherNodesTakeTasksOfBusyNodes) {
+    gb::CpuTopology const detected { gb::CpuTopology::detect() };
+    gb::CpuTopology const topology { { detected.getCpus(0), detected.getCpus(0) } };
+    gb::TaskRunner runner {
+        gb::TaskRunner::Options {
+            .workerCount = 2,
+            .workerAffinity = gb::TaskRunner::WorkerAffinity::Cpu,
+            .topology = &topology
+        }
+    };
+    // A worker of either node may take it before node 1's is up, so the busy node is the one
+    // it ran on. Its only worker blocks until the next task for that node runs elsewhere.
+    std::shared_ptr<GatedNodeTask> const blocking { std::make_shared<GatedNodeTask>() };
+    blocking->setNodeAffinity(1);
+    runner.start(blocking);
+    size_t const busyNode { blocking->ranOn };
+    std::shared_ptr<NodeTask> const task { std::make_shared<NodeTask>() };
+    task->setNodeAffinity(busyNode);
+    runner.start(task);
+    task->awaitStop();
+    blocking->open();
+    blocking->awaitStop();
+    ASSERT_EQ(task->ranOn, 1 - busyNode);
+}
+
+gb::CoTask<> sleepFor(std::chrono::steady_clock::duration const duration) {
+    co_await gb::coSleep(duration);
+}
+
+class AdmissionTaskRunnerTest : public BlockedWorkerTest {
+protected:
+    static gb::TaskRunner::Options boundedPool(gb::TaskRunner::OverflowPolicy const policy) noexcept {
+        return { .workerCount = 1, .maxQueuedTasks = 2, .overflowPolicy = policy };
+    }
+};
+
+TEST_F(AdmissionTaskRunnerTest, canRejectTasks) {
+    gb::TaskRunner runner { boundedPool(gb::TaskRunner::OverflowPolicy::Reject) };
+    blockWorker(runner);
+    ASSERT_TRUE(runner.submit([]{}).isValid());
+    ASSERT_TRUE(runner.submit([]{}).isValid());
+    ASSERT_FALSE(runner.submit([]{}).isValid());
+    unblockWorker();
+    runner.awaitAll();
+    gb::TaskRunner::AdmissionStats const stats { runner.getAdmissionStats() };
+    ASSERT_EQ(stats.admitted, 3);
+    ASSERT_EQ(stats.rejected, 1);
+}
+
+TEST_F(AdmissionTaskRunnerTest, canRunTasksOnCaller) {
+    gb::TaskRunner runner { boundedPool(gb::TaskRunner::OverflowPolicy::CallerRuns) };
+    blockWorker(runner);
+    std::ignore = runner.submit([]{});
+    std::ignore = runner.submit([]{});
+    gb::Future<std::thread::id> const ranOn { runner.submit([]{ return std::this_thread::get_id(); }) };
+    ASSERT_TRUE(ranOn.isReady());
+    ASSERT_EQ(ranOn.get(), std::this_thread::get_id());
+    unblockWorker();
+    runner.awaitAll();
+    ASSERT_EQ(runner.getAdmissionStats().ranByCaller, 1);
+}
+
+TEST_F(AdmissionTaskRunnerTest, canDropOldestTasks) {
+    gb::TaskRunner runner { boundedPool(gb::TaskRunner::OverflowPolicy::DropOldest) };
+    blockWorker(runner);
+    std::shared_ptr<StopWaitingTask> const oldest { std::make_shared<StopWaitingTask>() };
+    runner.startAsync(oldest);
+    std::ignore = runner.submit([]{});
+    gb::Future<void> const newest { runner.submit([]{}) };
+    // Dropped without running.
+    gb::Task::State const oldestState { oldest->getState() };
+    unblockWorker();
+    ASSERT_TRUE(newest.isValid());
+    newest.wait();
+    runner.awaitAll();
+    ASSERT_EQ(oldestState, gb::Task::State::Canceled);
+    gb::TaskRunner::AdmissionStats const stats { runner.getAdmissionStats() };
+    ASSERT_EQ(stats.dropped, 1);
+    ASSERT_EQ(stats.admitted, 4);
+}
+
+TEST_F(AdmissionTaskRunnerTest, dropsSubmittedFunctionsWithoutRunningThem) {
+    gb::TaskRunner runner { boundedPool(gb::TaskRunner::OverflowPolicy::DropOldest) };
+    blockWorker(runner);
+    std::atomic<bool> ranOldest { false };
+    gb::Future<int> const oldest { runner.submit([&ranOldest]{ ranOldest = true; return 1; }) };
+    std::ignore = runner.submit([]{ return 2; });
+    std::ignore = runner.submit([]{ return 3; });
+    bool const wasCanceled { oldest.isCanceled() };
+    unblockWorker();
+    runner.awaitAll();
+    ASSERT_TRUE(wasCanceled);
+    ASSERT_FALSE(ranOldest);
+    ASSERT_EQ(runner.getAdmissionStats().dropped, 1);
+}
+
+TEST_F(AdmissionTaskRunnerTest, canBlockUntilThereIsRoom) {
+    gb::TaskRunner runner { boundedPool(gb::TaskRunner::OverflowPolicy::Block) };
+    blockWorker(runner);
+    std::ignore = runner.submit([]{});
+    std::ignore = runner.submit([]{});
+    std::atomic<bool> admitted { false };
+    std::thread starter {
+        [&]{
+            std::ignore = runner.submit([]{});
+            admitted = true;
+        }
+    };
+    // Counted as blocked before waiting, and there is no room until the worker is unblocked.
+    while (runner.getAdmissionStats().blocked == 0) {
+        std::this_thread::yield();
+    }
+    bool const wasBlocked { !admitted };
+    unblockWorker();
+    starter.join();
+    runner.awaitAll();
+    ASSERT_TRUE(wasBlocked);
+    ASSERT_TRUE(admitted);
+    ASSERT_EQ(runner.getAdmissionStats().blocked, 1);
+}
+
+TEST_F(AdmissionTaskRunnerTest, boundsBatches) {
+    gb::TaskRunner runner {
+        gb::TaskRunner::ThreadOptions { .maxThreads = 2, .overflowPolicy = gb::TaskRunner::OverflowPolicy::Reject }
+    };
+    std::vector<std::shared_ptr<gb::Task>> const batch {
+        std::make_shared<StopWaitingTask>(), std::make_shared<StopWaitingTask>(),
+        std::make_shared<StopWaitingTask>()
+    };
+    ASSERT_EQ(runner.startAll(batch), 2);
+    runner.cancelAll();
+    runner.awaitAll();
+    ASSERT_EQ(runner.getAdmissionStats().rejected, 1);
+}
+
+TEST_F(AdmissionTaskRunnerTest, canBoundTaskThreads) {
+    gb::TaskRunner runner {
+        gb::TaskRunner::ThreadOptions { .maxThreads = 1, .overflowPolicy = gb::TaskRunner::OverflowPolicy::Reject }
+    };
+    std::shared_ptr<StopWaitingTask> const first { std::make_shared<StopWaitingTask>() };
+    std::shared_ptr<StopWaitingTask> const second { std::make_shared<StopWaitingTask>() };
+    ASSERT_TRUE(runner.start(first));
+    ASSERT_FALSE(runner.start(second));
+    first->cancel();
+    first->awaitStop();
+    ASSERT_EQ(runner.getAdmissionStats().rejected, 1);
+}
+
+TEST_F(AdmissionTaskRunnerTest, givesOverflowingCoroutinesTheirOwnThread) {
+    gb::TaskRunner runner {
+        gb::TaskRunner::ThreadOptions { .maxThreads = 1, .overflowPolicy = gb::TaskRunner::OverflowPolicy::CallerRuns }
+    };
+    std::shared_ptr<StopWaitingTask> const first { std::make_shared<StopWaitingTask>() };
+    gb::CoTask<> const task { sleepFor(std::chrono::milliseconds(10)) };
+    ASSERT_TRUE(runner.start(first));
+    ASSERT_TRUE(runner.start(task));
+    // Resumed after its sleep, instead of left suspended on this thread.
+    task.awaitStop();
+    first->cancel();
+    runner.awaitAll();
+    ASSERT_EQ(task.getState(), gb::Task::State::Finished);
+    ASSERT_EQ(runner.getAdmissionStats().ranByCaller, 1);
+}
+
+std::vector<int> simulatedRunOrder(uint64_t const seed) {
+    gb::TaskRunner runner { gb::TaskRunner::SimulationOptions { .seed = seed } };
+    std::vector<int> order;
+    for (int i = 0; i < 20; ++i) {
+        runner.submit([&order, i]{ order.push_back(i); });
+    }
+    EXPECT_TRUE(order.empty());
+    runner.runUntilIdle();
+    return order;
+}
+
+TEST(SimulatedTaskRunnerTest, interleavesTasksBySeed) {
+    std::vector<int> const order { simulatedRunOrder(1) };
+    ASSERT_EQ(order.size(), 20);
+    ASSERT_EQ(simulatedRunOrder(1), order);
+    ASSERT_NE(simulatedRunOrder(2), order);
+}
+
+TEST(SimulatedTaskRunnerTest, sleepsOnVirtualClock) {
+    gb::TaskRunner runner { gb::TaskRunner::SimulationOptions {} };
+    gb::CoTask<> const task { sleepFor(std::chrono::hours(1)) };
+    runner.start(task);
+    runner.runUntilIdle();
+    ASSERT_FALSE(task.isStopped());
+    runner.advance(std::chrono::minutes(59));
+    ASSERT_FALSE(task.isStopped());
+    runner.advance(std::chrono::minutes(1));
+    ASSERT_TRUE(task.isStopped());
+    ASSERT_EQ(runner.now().time_since_epoch(), std::chrono::hours(1));
+}
+
+TEST(SimulatedTaskRunnerTest, awaitAllMovesClockToLastTimer) {
+    gb::TaskRunner runner { gb::TaskRunner::SimulationOptions { .seed = 7 } };
+    gb::CoTask<> const shortTask { sleepFor(std::chrono::seconds(5)) };
+    gb::CoTask<> const longTask { sleepFor(std::chrono::seconds(30)) };
+    runner.start(shortTask);
+    runner.start(longTask);
+    runner.awaitAll();
+    ASSERT_TRUE(shortTask.isStopped());
+    ASSERT_TRUE(longTask.isStopped());
+    ASSERT_EQ(runner.now().time_since_epoch(), std::chrono::seconds(30));
+}
+
+gb::CoTask<> awaitAfterShutdown([[maybe_unused]] std::shared_ptr<int> const token) {
+    while (true) {
+        bool const shouldCancel { co_await gb::coShouldCancel() };
+        if (shouldCancel) {
+            break;
+        }
+        co_await gb::coSleep(std::chrono::seconds(1));
+    }
+    // The runner is shutting down by now, so this is never started.
+    co_await sleepFor(std::chrono::seconds(1));
+}
+
+TEST(SimulatedTaskRunnerTest, releasesTasksLeftAtShutdown) {
+    std::shared_ptr<int> const token { std::make_shared<int>(0) };
+    {
+        gb::TaskRunner runner { gb::TaskRunner::SimulationOptions {} };
+        gb::CoTask<> const task { awaitAfterShutdown(token) };
+        runner.start(task);
+        runner.advance(std::chrono::seconds(3));
+        runner.shutdown();
+        ASSERT_TRUE(task.isStopped());
+    }
+    // Only the coroutine's frame held it.
+    ASSERT_EQ(token.use_count(), 1);
+}
+
+TEST(SimulatedTaskRunnerTest, startRunsTaskUntilStarted) {
+    gb::TaskRunner runner { gb::TaskRunner::SimulationOptions {} };
+    std::shared_ptr<SimpleTask> const task { std::make_shared<SimpleTask>() };
+    ASSERT_TRUE(runner.start(task));
+    ASSERT_NE(task->getState(), gb::Task::State::Created);
+    ASSERT_TRUE(task->items.contains("one"));
+}
+
+class HeartbeatTask : public gb::Task {
+private:
+    std::atomic<bool>& gate;
+
+public:
+    explicit HeartbeatTask(std::atomic<bool>& gate) noexcept : gate(gate) {}
+
+protected:
+    void action() noexcept override {
+        started();
+        while (!gate) {
+            heartbeat();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+};
+
+TEST(WatchdogTaskRunnerTest, reportsTasksWithoutHeartbeat) {
+    gb::TaskRunner runner { 2 };
+    // Far above the beating task's interval, so it's never late enough to be reported.
+    std::chrono::milliseconds const threshold { 500 };
+    std::shared_ptr<GatedTask> const silentTask { std::make_shared<GatedTask>(false) };
+    std::shared_ptr<HeartbeatTask> const beatingTask { std::make_shared<HeartbeatTask>(silentTask->gate) };
+    std::mutex stuckLock;
+    std::condition_variable stuckSignal;
+    std::vector<gb::TaskRunner::StuckTask> stuck;
+    runner.enableWatchdog(threshold, [&](gb::TaskRunner::StuckTask const& task) {
+        std::lock_guard<std::mutex> lock { stuckLock };
+        stuck.push_back(task);
+        stuckSignal.notify_all();
+    });
+    runner.start(silentTask);
+    runner.start(beatingTask);
+    std::unique_lock<std::mutex> lock { stuckLock };
+    stuckSignal.wait_for(lock, std::chrono::seconds(30), [&]{
+        return std::ranges::any_of(stuck, [&](auto const& task) { return task.taskId == silentTask->getId(); });
+    });
+    std::vector<gb::TaskRunner::StuckTask> const reported { stuck };
+    lock.unlock();
+    // Stays silent until reported, then both stop.
+    silentTask->open();
+    runner.awaitAll();
+    // Once per stall, and only the silent one.
+    ASSERT_EQ(reported.size(), 1);
+    ASSERT_EQ(reported[0].taskId, silentTask->getId());
+    ASSERT_EQ(reported[0].state, gb::Task::State::Started);
+    ASSERT_GE(reported[0].silence, threshold);
+}
+
+TEST(WatchdogTaskRunnerTest, heartbeatIsOnlyKeptWithWatchdog) {
+    gb::TaskRunner runner { 1 };
+    std::shared_ptr<GatedTask> const task { std::make_shared<GatedTask>(false) };
+    runner.start(task);
+    ASSERT_EQ(task->getLastHeartbeat(), std::chrono::steady_clock::time_point {});
+    task->open();
+}
+
+TEST(WatchdogTaskRunnerTest, heartbeatIsClearedOnceDone) {
+    gb::TaskRunner runner { 1 };
+    runner.enableWatchdog(std::chrono::hours(1), [](gb::TaskRunner::StuckTask const&) {});
+    std::shared_ptr<GatedTask> const task { std::make_shared<GatedTask>(false) };
+    runner.start(task);
+    ASSERT_NE(task->getLastHeartbeat(), std::chrono::steady_clock::time_point {});
+    task->open();
+    runner.awaitAll();
+    ASSERT_EQ(task->getLastHeartbeat(), std::chrono::steady_clock::time_point {});
+}
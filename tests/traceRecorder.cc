@@ -0,0 +1,104 @@
+// Copyright 2024 GlitchyByte
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glitchybyte/gb/gb.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(TraceRecorder, writesEmptyTrace) {
+    gb::TraceRecorder recorder;
+    std::ostringstream out;
+    recorder.write(out);
+    ASSERT_EQ(out.str(), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n");
+}
+
+TEST(TraceRecorder, writesEventsPerThread) {
+    gb::TraceRecorder recorder;
+    uint64_t const id { recorder.newId() };
+    recorder.begin("main", id);
+    std::thread thread {
+        [&recorder]{
+            uint64_t const threadId { recorder.newId() };
+            recorder.begin("other", threadId);
+            recorder.end("other", threadId);
+        }
+    };
+    thread.join();
+    recorder.end("main", id);
+    std::ostringstream out;
+    recorder.write(out);
+    std::string const trace { out.str() };
+    ASSERT_NE(trace.find("\"name\":\"main\",\"ph\":\"B\",\"pid\":1,\"tid\":1,"), std::string::npos);
+    ASSERT_NE(trace.find("\"name\":\"main\",\"ph\":\"E\",\"pid\":1,\"tid\":1,"), std::string::npos);
+    ASSERT_NE(trace.find("\"name\":\"other\",\"ph\":\"B\",\"pid\":1,\"tid\":2,"), std::string::npos);
+    ASSERT_NE(trace.find("\"name\":\"other\",\"ph\":\"E\",\"pid\":1,\"tid\":2,"), std::string::npos);
+    ASSERT_NE(trace.find("\"args\":{\"id\":2}"), std::string::npos);
+}
+
+TEST(TraceRecorder, keepsThreadsApartAcrossRecorders) {
+    gb::TraceRecorder first;
+    gb::TraceRecorder second;
+    first.begin("first", 1);
+    second.begin("second", 1);
+    first.end("first", 1);
+    std::ostringstream out;
+    first.write(out);
+    std::string const trace { out.str() };
+    ASSERT_NE(trace.find("\"name\":\"first\",\"ph\":\"E\",\"pid\":1,\"tid\":1,"), std::string::npos);
+    ASSERT_EQ(trace.find("second"), std::string::npos);
+}
+
+TEST(TraceRecorder, keepsMostRecentEventsPerThread) {
+    gb::TraceRecorder recorder { 3 };
+    recorder.begin("old", 1);
+    recorder.end("old", 1);
+    recorder.begin("new", 2);
+    recorder.end("new", 2);
+    std::ostringstream out;
+    recorder.write(out);
+    std::string const trace { out.str() };
+    ASSERT_EQ(trace.find("\"name\":\"old\",\"ph\":\"B\""), std::string::npos);
+    size_t const oldEnd { trace.find("\"name\":\"old\",\"ph\":\"E\"") };
+    size_t const newBegin { trace.find("\"name\":\"new\",\"ph\":\"B\"") };
+    size_t const newEnd { trace.find("\"name\":\"new\",\"ph\":\"E\"") };
+    ASSERT_NE(newEnd, std::string::npos);
+    ASSERT_LT(oldEnd, newBegin);
+    ASSERT_LT(newBegin, newEnd);
+}
+
+TEST(TraceRecorder, keepsMostRecentThreads) {
+    gb::TraceRecorder recorder { 16, 2 };
+    // Threads stay alive until the end, so none reuses the id of another.
+    std::atomic<bool> gate { false };
+    std::vector<std::thread> threads;
+    auto const recordOnThread {
+        [&](char const* const name) {
+            std::atomic<bool> recorded { false };
+            threads.emplace_back([&recorder, &gate, &recorded, name]{
+                recorder.begin(name, 1);
+                recorded = true;
+                recorded.notify_all();
+                gate.wait(false);
+            });
+            recorded.wait(false);
+        }
+    };
+    recorder.begin("main", 1);
+    recordOnThread("first");
+    // Takes over main's buffer, whose last event is oldest.
+    recordOnThread("second");
+    // Main then takes over the first thread's buffer.
+    recorder.begin("main again", 2);
+    gate = true;
+    gate.notify_all();
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+    std::ostringstream out;
+    recorder.write(out);
+    std::string const trace { out.str() };
+    ASSERT_EQ(trace.find("\"name\":\"main\","), std::string::npos);
+    ASSERT_EQ(trace.find("\"name\":\"first\","), std::string::npos);
+    ASSERT_NE(trace.find("\"name\":\"second\",\"ph\":\"B\",\"pid\":1,\"tid\":3,"), std::string::npos);
+    ASSERT_NE(trace.find("\"name\":\"main again\",\"ph\":\"B\",\"pid\":1,\"tid\":4,"), std::string::npos);
+}